@@ -0,0 +1,70 @@
+#pragma once
+// std
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// blocking fifo with a fixed capacity, used between pipeline stages.
+template <typename T>
+class BoundedQueue
+{
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed = false;
+	std::mutex m_mutex;
+	std::condition_variable m_not_empty;
+	std::condition_variable m_not_full;
+public:
+	BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+	// wait for room, false if the queue was closed.
+	bool push(const T & item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_full.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+		if (m_closed)
+			return false;
+		m_items.push_back(item);
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	// no waiting, false if full or closed: the item is dropped.
+	bool try_push(const T & item)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_closed || m_items.size() >= m_capacity)
+			return false;
+		m_items.push_back(item);
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	// wait for an item, false once closed and drained.
+	bool pop(T & item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+		if (m_items.empty())
+			return false;
+		item = m_items.front();
+		m_items.pop_front();
+		m_not_full.notify_one();
+		return true;
+	}
+
+	// no more pushes, poppers drain the rest.
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_not_empty.notify_all();
+		m_not_full.notify_all();
+	}
+
+	size_t size()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_items.size();
+	}
+};
@@ -1,6 +1,8 @@
 // std
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <string.h>
+#include <string>
 // ros
 #include "ros/ros.h"
 
@@ -8,6 +10,8 @@
 #include "data_engine.h"
 // navigation
 #include "navigation.h"
+// debug images
+#include "vis_sink.h"
 
 using namespace std;
 
@@ -19,7 +23,35 @@ int main(int argc, char **argv)
 {
     // set up ros env
     ros::init(argc, argv, "co_scan");
-    ros::NodeHandle n;
+
+    // session log: --record <path> saves every scan, --replay <path> [--paced] runs offline from a log.
+    // debug images: --vis off|summary|full.
+    string record_path, replay_path;
+    bool replay_paced = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (strcmp(argv[i], "--paced") == 0)
+            replay_paced = true;
+        else if (strcmp(argv[i], "--vis") == 0 && i + 1 < argc)
+        {
+            // debug images: off, summary or full (default)
+            i++;
+            if (strcmp(argv[i], "off") == 0)
+                g_vis_level = VIS_OFF;
+            else if (strcmp(argv[i], "summary") == 0)
+                g_vis_level = VIS_SUMMARY;
+            else
+                g_vis_level = VIS_FULL;
+        }
+    }
+    // replay needs no ros master.
+    ros::NodeHandle* n = NULL;
+    if (replay_path.empty())
+        n = new ros::NodeHandle();
 
     // set up global variables
     {
@@ -36,6 +68,13 @@ int main(int argc, char **argv)
 
     // data engine
     DataEngine de(rbt_num);
+    if (!replay_path.empty() && !de.startReplay(replay_path, replay_paced))
+        return -1;
+    if (!record_path.empty())
+    {
+        de.startRecording(record_path);
+        g_tsp_log_path = record_path + ".tsp";
+    }
     de.initialize();
 
     // navigation
@@ -48,6 +87,9 @@ int main(int argc, char **argv)
     while(1)
     {
 PLAN:
+        // offline run: stop once the log is used up
+        if (de.replayDone())
+            goto END;
         // motion planning
         nav.processCurrentScene();
         nav.OMT_TSP();
@@ -67,5 +109,5 @@ END:
     de.showCellMap();
     // finished.
     printf("program done.\n");
-    return 0;
+    return de.replayStatus();
 }
\ No newline at end of file
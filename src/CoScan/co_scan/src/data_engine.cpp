@@ -62,6 +62,8 @@ void stopThread(int sockClient)
 // get rgbd
 bool DataEngine::getRGBDFromServer()
 {
+    if (replaying())
+        return replayRGBD();
 
 // test
     sleep(0.1);
@@ -163,22 +165,8 @@ getRGBDFromGazebo_begin:
         //cout<<"successfully recved rgb package."<<endl;
 
         // convert package data to rgb images
-        int ind = 0;
-        for (int id = 0; id < rbt_num; id++)
-        {
-            for (int i = 0; i < 480; i++)
-            {
-                for (int j = 0; j < 640; j++)
-                {
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][2], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][1], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][0], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                }
-            }
-        }
+        unpackRGB(rcvData);
+        recordPayload(SCANLOG_RGB, rcvData, data_len);
         delete [] rcvData;
     }
 
@@ -211,18 +199,8 @@ getRGBDFromGazebo_begin:
             count += n;
         }
         // cpy to depth
-        int ind = 0;
-        for (int id = 0; id < rbt_num; id++)
-        {
-            for (int i = 0; i < 480; i++)
-            {
-                for (int j = 0; j < 640; j++)
-                {
-                    memcpy(&m_depth[id].ptr<ushort>(i)[j], &rcvData[ind], sizeof(short));
-                    ind += sizeof(short);
-                }
-            }
-        }
+        unpackDepth(rcvData);
+        recordPayload(SCANLOG_DEPTH, rcvData, data_len);
         delete [] rcvData;
     }
 
@@ -243,6 +221,8 @@ getRGBDFromGazebo_begin:
 // get pose
 bool DataEngine::getPoseFromServer()
 {
+    if (replaying())
+        return replayPose();
     // set up: rcv data
     int data_len = (7 * sizeof(float) * rbt_num);
     char* rcvData = new char[data_len];
@@ -307,15 +287,7 @@ getPoseFromLinux_begin:
         count += n;
     }
     // cpy to pose
-    int ind = 0;
-    for (int id = 0; id < rbt_num; id++)
-    {
-        for (int i = 0; i < 7; i++)
-        {
-            memcpy(&m_pose[id][i], &rcvData[ind], sizeof(float));
-            ind += sizeof(float);
-        }
-    }
+    unpackPose(rcvData);
     // test
     for (int rid = 0; rid < rbt_num; rid++)
     {
@@ -342,6 +314,7 @@ getPoseFromLinux_begin:
             goto getPoseFromLinux_begin;
         }
     }
+    recordPayload(SCANLOG_POSE, rcvData, data_len);
     delete [] rcvData;
     cerr << "done." << endl;
     return true;
@@ -349,6 +322,8 @@ getPoseFromLinux_begin:
 
 bool DataEngine::rcvRGBDFromServer()
 {
+    if (replaying())
+        return replayRGBD();
     cerr << "waitting for rgbd data ... ";
     // recive data
     // rgb
@@ -387,22 +362,8 @@ bool DataEngine::rcvRGBDFromServer()
             count += n;
         }
         // cpy to rgb
-        int ind = 0;
-        for (int id = 0; id < rbt_num; id++)
-        {
-            for (int i = 0; i < 480; i++)
-            {
-                for (int j = 0; j < 640; j++)
-                {
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][2], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][1], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                    memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][0], &rcvData[ind], sizeof(uchar));
-                    ind += sizeof(uchar);
-                }
-            }
-        }
+        unpackRGB(rcvData);
+        recordPayload(SCANLOG_RGB, rcvData, data_len);
         delete [] rcvData;
     }
 
@@ -452,18 +413,8 @@ bool DataEngine::rcvRGBDFromServer()
             count += n;
         }
         // cpy to depth
-        int ind = 0;
-        for (int id = 0; id < rbt_num; id++)
-        {
-            for (int i = 0; i < 480; i++)
-            {
-                for (int j = 0; j < 640; j++)
-                {
-                    memcpy(&m_depth[id].ptr<ushort>(i)[j], &rcvData[ind], sizeof(short));
-                    ind += sizeof(short);
-                }
-            }
-        }
+        unpackDepth(rcvData);
+        recordPayload(SCANLOG_DEPTH, rcvData, data_len);
         delete [] rcvData;
     }
 
@@ -482,6 +433,8 @@ bool DataEngine::rcvRGBDFromServer()
 
 bool DataEngine::rcvPoseFromServer()
 {
+    if (replaying())
+        return replayPose();
     cerr << "waitting for pose data ... ";
     // rcv data
     int data_len = (7 * sizeof(float) * rbt_num);
@@ -521,20 +474,8 @@ bool DataEngine::rcvPoseFromServer()
     }
     //cout << "final count: " << count << endl;
     // cpy to pose
-    int ind = 0;
-    for (int id = 0; id < rbt_num; id++)
-    {
-        for (int i = 0; i < 7; i++)
-        {
-            memcpy(&m_pose[id][i], &rcvData[ind], sizeof(float));
-            ind += sizeof(float);
-        }
-        /*cout << "pose" << id << ": " << endl;
-        for (int i = 0; i < 7; i++){
-        cout << pose[id][i] << " ";
-        }
-        cout << endl;*/
-    }
+    unpackPose(rcvData);
+    recordPayload(SCANLOG_POSE, rcvData, data_len);
 
     delete [] rcvData;
     cerr << "done" << endl;
@@ -544,6 +485,8 @@ bool DataEngine::rcvPoseFromServer()
 // ask to set up surroundings, use to initialization
 void DataEngine::scanSurroundingsCmd()
 {
+    if (replaying())
+        return;
     // ask for data
     char sendData[1];
     sendData[0] = '5';
@@ -553,6 +496,9 @@ void DataEngine::scanSurroundingsCmd()
 // move to views
 bool DataEngine::socket_move_to_views(vector<vector<double>> poses)
 {
+    // the log already holds the scans at the recorded views.
+    if (replaying())
+        return true;
 // test
     sleep(0.1);
     stopThread(sockClient);
@@ -581,17 +527,146 @@ bool DataEngine::socket_move_to_views(vector<vector<double>> poses)
     return true;
 }
 
+// wire format to pose
+void DataEngine::unpackPose(const char* data)
+{
+    int ind = 0;
+    for (int id = 0; id < rbt_num; id++)
+    {
+        for (int i = 0; i < 7; i++)
+        {
+            memcpy(&m_pose[id][i], &data[ind], sizeof(float));
+            ind += sizeof(float);
+        }
+    }
+}
+
+// wire format to rgb
+void DataEngine::unpackRGB(const char* data)
+{
+    int ind = 0;
+    for (int id = 0; id < rbt_num; id++)
+    {
+        for (int i = 0; i < 480; i++)
+        {
+            for (int j = 0; j < 640; j++)
+            {
+                memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][2], &data[ind], sizeof(uchar));
+                ind += sizeof(uchar);
+                memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][1], &data[ind], sizeof(uchar));
+                ind += sizeof(uchar);
+                memcpy(&m_rgb[id].ptr<cv::Vec3b>(i)[j][0], &data[ind], sizeof(uchar));
+                ind += sizeof(uchar);
+            }
+        }
+    }
+}
+
+// wire format to depth
+void DataEngine::unpackDepth(const char* data)
+{
+    int ind = 0;
+    for (int id = 0; id < rbt_num; id++)
+    {
+        for (int i = 0; i < 480; i++)
+        {
+            for (int j = 0; j < 640; j++)
+            {
+                memcpy(&m_depth[id].ptr<ushort>(i)[j], &data[ind], sizeof(short));
+                ind += sizeof(short);
+            }
+        }
+    }
+}
+
+// record every received pose and rgbd
+bool DataEngine::startRecording(const string & path)
+{
+    m_log_step = 0;
+    return m_recorder.open(path);
+}
+
+// serve poses and rgbd from a recorded log instead of the server
+bool DataEngine::startReplay(const string & path, bool paced)
+{
+    m_log_step = 0;
+    return m_replayer.open(path, paced);
+}
+
+// append a received payload to the session log, a pose opens a new step.
+void DataEngine::recordPayload(int type, const char* data, int data_len)
+{
+    if (type == SCANLOG_POSE)
+        m_log_step++;
+    if (m_recorder.isOpen())
+        m_recorder.write(type, m_log_step, rbt_num, data, data_len);
+}
+
+// stop the replay, later calls get no data
+bool DataEngine::stopReplay(int status)
+{
+    if (!m_replay_done)
+        cerr << "replay finished after step " << m_log_step << endl;
+    m_replay_done = true;
+    if (status > m_replay_status)
+        m_replay_status = status;
+    return false;
+}
+
+// next recorded pose
+bool DataEngine::replayPose()
+{
+    if (m_replay_done)
+        return false;
+    vector<char> payload;
+    ScanLogRecord record;
+    if (!m_replayer.next(SCANLOG_POSE, payload, record))
+        return stopReplay(0);
+    if (record.rbt_num != rbt_num || record.length != 7 * sizeof(float) * rbt_num)
+    {
+        cerr << "error in " << __FUNCTION__ << ", log recorded with " << record.rbt_num << " robots, running with " << rbt_num << endl;
+        return stopReplay(1);
+    }
+    m_log_step = record.step;
+    unpackPose(&payload[0]);
+    return true;
+}
+
+// next recorded rgbd
+bool DataEngine::replayRGBD()
+{
+    if (m_replay_done)
+        return false;
+    vector<char> payload;
+    ScanLogRecord record;
+    if (!m_replayer.next(SCANLOG_RGB, payload, record))
+        return stopReplay(0);
+    if (record.length != 480 * 640 * 3 * sizeof(uchar) * rbt_num)
+    {
+        cerr << "error in " << __FUNCTION__ << ", rgb record of step " << record.step << " has " << record.length << " bytes" << endl;
+        return stopReplay(1);
+    }
+    unpackRGB(&payload[0]);
+    if (!m_replayer.next(SCANLOG_DEPTH, payload, record))
+        return stopReplay(0);
+    if (record.length != 480 * 640 * sizeof(short) * rbt_num)
+    {
+        cerr << "error in " << __FUNCTION__ << ", depth record of step " << record.step << " has " << record.length << " bytes" << endl;
+        return stopReplay(1);
+    }
+    unpackDepth(&payload[0]);
+    return true;
+}
+
 // set up scan envir, not finished
 void DataEngine::SetUpSurroundings()
 {
     scanSurroundingsCmd();
-    for (int i = 0; i < 6; i++)
+    // insert scans multi-robot to tree and project to 2d while the next turn is received
+    scanPipeline(6, [this](int k)
     {
-        rcvPoseFromServer();
-        rcvRGBDFromServer();
-        fuseScans2MapAndTree(); // insert scans multi-robot to tree
-        projectOctree2Map(); // project to 2d
-    }
+        return rcvPoseFromServer() && rcvRGBDFromServer();
+    }, nullptr);
 }
 
 // coordinate system transfer
@@ -838,6 +913,7 @@ void DataEngine::projectOctree2Map()
 
 // todo: uncertainty 2d 
 
+    m_map_version++;
     return;
 }
 //*/
@@ -970,6 +1046,7 @@ void DataEngine::findExtraFreeSpace(int rid, cv::Mat depth, vector<float> pose)
                 space_contour.push_back(cv::Point(v, u));
             }
             m_free_space_contours2d[rid] = space_contour; // save
+            markDirty(space_contour);
         }
 /*
         // draw contours
@@ -1211,6 +1288,7 @@ void DataEngine::fuseScans2MapAndTree()
         // update robot viewports
         pair<Eigen::MatrixXd, Eigen::Vector3d> rt = coord_trans_7f_rt(m_pose[rid]);
         m_frustum_contours[rid] = loadIdealFrustum(rt.first, rt.second);
+        markDirty(m_frustum_contours[rid]);
     }
     
     // todo: keyframe count
@@ -1218,10 +1296,129 @@ void DataEngine::fuseScans2MapAndTree()
     return;
 }
 
+// fuse a decoded batch, same steps as fuseScans2MapAndTree.
+void DataEngine::fuseScanBatch(ScanBatch & batch)
+{
+    for (int rid = 0; rid < rbt_num; ++rid)
+    {
+        // update octree
+        m_recon3D.m_tree->insertPointCloud(*batch.clouds[rid], batch.origins[rid]);
+        m_recon3D.m_tree->updateInnerOccupancy();
+        delete batch.clouds[rid];
+        batch.clouds[rid] = NULL;
+        // find extra free space that octree cant record
+        findExtraFreeSpace(rid, batch.depths[rid], batch.poses[rid]);
+        // update robot poses
+        m_pose2d[rid] = coord_trans_7f_se2(batch.poses[rid]);
+        // update robot viewports
+        pair<Eigen::MatrixXd, Eigen::Vector3d> rt = coord_trans_7f_rt(batch.poses[rid]);
+        m_frustum_contours[rid] = loadIdealFrustum(rt.first, rt.second);
+        markDirty(m_frustum_contours[rid]);
+    }
+    return;
+}
+
+// wall seconds
+double stageNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// stage timing report
+void ScanStageTiming::print(double wall)
+{
+    if (rounds == 0) return;
+    cerr << "scan pipeline, " << rounds << " rounds, wall " << wall << " s, " << wall / rounds << " s per round" << endl;
+    cerr << "  acquire " << acquire << " s, decode " << decode << " s, fuse " << fuse << " s, project " << project << " s, after " << after << " s" << endl;
+    cerr << "  acquire blocked on full queue " << acquire_wait << " s, fusion starved " << fuse_wait << " s" << endl;
+}
+
+// receive and decode round k+1 while round k is fused and projected.
+// acquire(k) runs on the receive thread and must leave poses and frames in m_pose / m_depth; it is the only socket user meanwhile.
+// it returns false when there is no more data, the rounds received so far are still fused.
+// after(k) runs on the calling thread once round k is in the 2d map.
+ScanStageTiming DataEngine::scanPipeline(int rounds, std::function<bool(int)> acquire, std::function<void(int)> after)
+{
+    ScanStageTiming timing;
+    BoundedQueue<ScanBatch*> queue(scan_queue_capacity);
+    double tb = stageNow();
+    // receive + decode
+    std::thread receiver([&]()
+    {
+        for (int k = 0; k < rounds; k++)
+        {
+            double t0 = stageNow();
+            if (!acquire(k))
+                break;
+            double t1 = stageNow();
+            ScanBatch* batch = new ScanBatch();
+            batch->round = k;
+            batch->poses = m_pose;
+            batch->depths.resize(rbt_num);
+            batch->clouds.resize(rbt_num);
+            batch->origins.resize(rbt_num);
+            for (int rid = 0; rid < rbt_num; ++rid)
+            {
+                batch->depths[rid] = m_depth[rid].clone();
+                batch->clouds[rid] = frame2Pointcloud(batch->depths[rid], batch->poses[rid], batch->origins[rid]);
+            }
+            double t2 = stageNow();
+            queue.push(batch);
+            double t3 = stageNow();
+            timing.acquire += t1 - t0;
+            timing.decode += t2 - t1;
+            timing.acquire_wait += t3 - t2;
+        }
+        queue.close();
+    });
+    // fuse + project + after
+    ScanBatch* batch = NULL;
+    while (true)
+    {
+        double t0 = stageNow();
+        if (!queue.pop(batch))
+            break;
+        double t1 = stageNow();
+        fuseScanBatch(*batch);
+        double t2 = stageNow();
+        projectOctree2Map();
+        double t3 = stageNow();
+        if (after)
+            after(batch->round);
+        double t4 = stageNow();
+        delete batch;
+        timing.fuse_wait += t1 - t0;
+        timing.fuse += t2 - t1;
+        timing.project += t3 - t2;
+        timing.after += t4 - t3;
+        timing.rounds++;
+    }
+    receiver.join();
+    timing.print(stageNow() - tb);
+    return timing;
+}
+
 // insert a frame to octree
 void DataEngine::insertAFrame2Tree(cv::Mat & depth, vector<float> pose)
 {
     double tb = clock(); // timing
+    octomap::point3d origin;
+    octomap::Pointcloud* pc = frame2Pointcloud(depth, pose, origin);
+    // inset into tree
+    m_recon3D.m_tree->insertPointCloud(*pc, origin); // cause error. cause error? it works well 2018-12-26.
+    // update tree occupancy
+    m_recon3D.m_tree->updateInnerOccupancy();
+    delete pc;
+    double te = clock(); // timing
+    cerr << "inserted a frame to octree, timing " << (te - tb)/CLOCKS_PER_SEC << " s" << endl;
+    return;
+}
+
+// depth frame to point cloud in octomap world coordinate, no tree access so it can run beside fusion.
+octomap::Pointcloud* DataEngine::frame2Pointcloud(cv::Mat & depth, const vector<float> & pose, octomap::point3d & sensor_origin)
+{
     // check nan
     for (int i = 0; i < pose.size(); ++i)
     {
@@ -1335,26 +1532,8 @@ void DataEngine::insertAFrame2Tree(cv::Mat & depth, vector<float> pose)
     }
     Eigen::Vector3d origin(0, 0, 0);
     origin = r*origin + t; //-origin[1], -origin[2], origin[0]; // octomap world coordinate
-/*
-    if (__isnan(origin[0])||__isnan(origin[1])||__isnan(origin[2]))
-    {
-        cerr<<"pose nan"<<endl;
-        getchar();getchar();getchar();
-        exit(-1);
-    }
-    else
-//*/
-    {
-        // inset into tree
-        //m_recon3D.m_tree->insertPointCloudRays(pc, octomap::point3d(-origin[1], -origin[2], origin[0])); // openmp inside their code.
-        m_recon3D.m_tree->insertPointCloud(pc, octomap::point3d(-origin[1], -origin[2], origin[0])); // cause error. cause error? it works well 2018-12-26.
-        // update tree occupancy
-        m_recon3D.m_tree->updateInnerOccupancy();
-    }
-    delete pc;
-    double te = clock(); // timing
-    cerr << "inserted a frame to octree, timing " << (te - tb)/CLOCKS_PER_SEC << " s" << endl;
-    return;
+    sensor_origin = octomap::point3d(-origin[1], -origin[2], origin[0]);
+    return pc;
 }
 
 // vis
@@ -1377,6 +1556,54 @@ cv::Mat DataEngine::visCellMap()
     return vis_mat;
 }
 
+// visCellMap once per map version. a new image per version, so images handed out stay unchanged
+cv::Mat DataEngine::visCellMapCached()
+{
+    if (m_vis_map.empty() || m_vis_map_version != m_map_version)
+    {
+        m_vis_map = visCellMap();
+        m_vis_map_version = m_map_version;
+    }
+    return m_vis_map;
+}
+
+// scanned free cells 255, others 0
+cv::Mat DataEngine::freeMask()
+{
+    cv::Mat mask = cv::Mat::zeros(map_rows, map_cols, CV_8UC1);
+    for (int r = 0; r < mask.rows; r++)
+    {
+        uchar* row = mask.ptr<uchar>(r);
+        for (int c = 0; c < mask.cols; c++)
+        {
+            if (m_recon2D.m_cellmap[r][c].isScanned && m_recon2D.m_cellmap[r][c].isFree)
+                row[c] = 255;
+        }
+    }
+    return mask;
+}
+
+// mark the cells around a fused frustum or free contour as changed
+void DataEngine::markDirty(const std::vector<cv::Point> & contour)
+{
+    if (contour.empty())
+        return;
+    const int margin = 4; // octree leaves and scaled cells reach a little past the contour
+    cv::Rect rect = cv::boundingRect(contour);
+    rect = cv::Rect(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin);
+    rect &= cv::Rect(0, 0, map_cols, map_rows);
+    if (rect.area() > 0)
+        m_dirty_rects.push_back(rect);
+}
+
+// changed regions since the last call, then cleared
+std::vector<cv::Rect> DataEngine::takeDirtyRects()
+{
+    std::vector<cv::Rect> rects;
+    rects.swap(m_dirty_rects);
+    return rects;
+}
+
 // show
 cv::Mat DataEngine::showCellMap()
 {
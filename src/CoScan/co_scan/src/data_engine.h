@@ -12,6 +12,8 @@
 #include <netinet/tcp.h>
 #include <pthread.h>
 #include <thread>  
+#include <functional>
+#include <time.h>
 #include <arpa/inet.h>
 // opencv
 #include <opencv2/opencv.hpp>
@@ -27,6 +29,8 @@
 #include "../include/se2/se2.h"
 // my headers
 #include "global.h"
+#include "scan_log.h"
+#include "bounded_queue.h"
 
 // 2D recon
 struct CellMap{
@@ -97,6 +101,33 @@ public:
     }
 };
 
+// one received round of all robots, decoded to point clouds.
+struct ScanBatch
+{
+	int round = 0;
+	std::vector<std::vector<float>> poses;
+	std::vector<cv::Mat> depths;
+	std::vector<octomap::Pointcloud*> clouds;
+	std::vector<octomap::point3d> origins;
+};
+
+// accumulated stage wall time of the scan pipeline, seconds.
+struct ScanStageTiming
+{
+	double acquire = 0;			// move + pose + rgbd from server
+	double decode = 0;			// depth to point clouds
+	double fuse = 0;			// octree insertion, free space, frustums
+	double project = 0;			// octree to 2d map
+	double after = 0;			// caller stage, e.g. visualization
+	double acquire_wait = 0;	// receiver blocked by a full queue
+	double fuse_wait = 0;		// fusion waiting for data
+	int rounds = 0;
+	void print(double wall);
+};
+
+// wall seconds
+double stageNow();
+
 // process scanning data
 class DataEngine
 {
@@ -125,12 +156,25 @@ public:
 	// scene recon
     Recon3D m_recon3D;
     Recon2D m_recon2D;
+    int m_map_version = 0; // bumped when m_recon2D is rebuilt, keys map derived caches
+    cv::Mat m_vis_map; // visCellMap of m_vis_map_version
+    int m_vis_map_version = -1;
+    std::vector<cv::Rect> m_dirty_rects; // cells changed by fused scans since takeDirtyRects, (x = col, y = row)
     // 2d frustum
     std::vector<std::vector<cv::Point>> m_frustum_contours;
     // 2d free
     std::vector<std::vector<cv::Point>> m_free_space_contours2d;
     // 2d pose
     std::vector<iro::SE2> m_pose2d;
+	// session record and offline replay
+	ScanLogWriter m_recorder;
+	ScanLogReader m_replayer;
+	int m_log_step = 0;
+	// replay ran out of records, and the exit status: 0 end of log, 1 corrupt or mismatched log
+	bool m_replay_done = false;
+	int m_replay_status = 0;
+	// rounds received ahead of fusion
+	int scan_queue_capacity = 2;
 
 	// constructor
 	DataEngine(int r_num)
@@ -168,7 +212,8 @@ public:
 	int initialize()
 	{
 		// init
-		create_connection();
+		if (!replaying())
+			create_connection();
 
 		//todo
 
@@ -192,12 +237,44 @@ public:
 	// move to views
 	bool socket_move_to_views(std::vector<std::vector<double>> poses);
 
+	// record every received pose and rgbd to <path>.bin and <path>.idx
+	bool startRecording(const std::string & path);
+	// serve poses and rgbd from a recorded log instead of the server
+	bool startReplay(const std::string & path, bool paced);
+	// replay mode
+	bool replaying() { return m_replayer.isOpen(); }
+	// replay has no more scans, stop scanning
+	bool replayDone() { return m_replay_done; }
+	// exit status of the replay run
+	int replayStatus() { return m_replay_status; }
+	// append a received payload to the session log
+	void recordPayload(int type, const char* data, int data_len);
+	// next recorded pose, false once the log is done
+	bool replayPose();
+	// next recorded rgbd, false once the log is done
+	bool replayRGBD();
+	// stop the replay with an exit status
+	bool stopReplay(int status);
+	// wire format to frames
+	void unpackPose(const char* data);
+	void unpackRGB(const char* data);
+	void unpackDepth(const char* data);
+
 	// insert a frame 2 tree
 	void insertAFrame2Tree(cv::Mat & depth, std::vector<float> pose);
+
+	// depth frame to point cloud in octomap world coordinate
+	octomap::Pointcloud* frame2Pointcloud(cv::Mat & depth, const std::vector<float> & pose, octomap::point3d & sensor_origin);
 	
 	// fuse scans by multi-robot, update robot poses
 	void fuseScans2MapAndTree();
 
+	// fuse a decoded batch
+	void fuseScanBatch(ScanBatch & batch);
+
+	// overlap receive and decode of the next round with fusion and projection of the current one
+	ScanStageTiming scanPipeline(int rounds, std::function<bool(int)> acquire, std::function<void(int)> after);
+
 	// compute ideal frustum
 	std::vector<cv::Point> loadIdealFrustum(Eigen::MatrixXd r, Eigen::Vector3d t);
 
@@ -231,6 +308,18 @@ public:
 	// vis
 	cv::Mat visCellMap();
 
+	// visCellMap of the current map version, built once per version. shared, clone before drawing
+	cv::Mat visCellMapCached();
+
+	// scanned free cells 255, others 0
+	cv::Mat freeMask();
+
+	// mark the cells around a fused frustum or free contour as changed
+	void markDirty(const std::vector<cv::Point> & contour);
+
+	// changed regions since the last call, then cleared
+	std::vector<cv::Rect> takeDirtyRects();
+
 	// show
 	cv::Mat showCellMap();
 
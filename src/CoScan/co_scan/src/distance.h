@@ -11,6 +11,7 @@
 // other headers
 #include "global.h"
 #include "geodesic/Xin_Wang.h" 
+#include "tsp/thread_pool.h"
 
 // todo: organize distance funcs.
 
@@ -47,6 +48,10 @@ public:
 	double get_geodesic_distance_fast(Point_2 p0, Point_2 p1);
 	// geodesic distance
 	double get_geodesic_distance(Point_2 p0, Point_2 p1, vector<Point_2> & path);
+	// model vertex of a point, same snapping as the funcs above.
+	int findVertex(const CRichModel & model, Point_2 p);
+	// all pairs geodesic distances on the loaded domain, need get_geodesic_distance_fast_initialization. rows run on pool.
+	vector<vector<double>> getGeodesicDistanceMatrix(const vector<Point_2> & points, StealingPool & pool);
 };
 
 // euclidean distance
@@ -347,3 +352,75 @@ double DistanceMetric::get_geodesic_distance_fast(Point_2 p0, Point_2 p1)
 	double distance_result = distanceField[target_index];
 	return distance_result;
 }
+
+// model vertex of a point: the vertex in the same unit cell, otherwise the closest one.
+int DistanceMetric::findVertex(const CRichModel & model, Point_2 p)
+{
+	for (int i = 0; i < model.GetNumOfVerts(); i++)
+	{
+		if (ceil(model.m_Verts[i].x) == ceil(p.x()) && ceil(model.m_Verts[i].y) == ceil(p.y()))
+			return i;
+	}
+	double min_dis = DBL_MAX;
+	int min_index = -1;
+	for (int i = 0; i < model.GetNumOfVerts(); i++)
+	{
+		double crt_dis = get_euclidean_distance(Point_2(model.m_Verts[i].x, model.m_Verts[i].y), p);
+		if (crt_dis < min_dis){
+			min_dis = crt_dis;
+			min_index = i;
+		}
+	}
+	return min_index;
+}
+
+// all pairs geodesic distances.
+// one propagation per point on the shared read-only domain, each stops once the later points are reached.
+vector<vector<double>> DistanceMetric::getGeodesicDistanceMatrix(const vector<Point_2> & points, StealingPool & pool)
+{
+	int num = points.size();
+	vector<vector<double>> matrix(num, vector<double>(num, 0));
+	if (num < 2)
+		return matrix;
+	if (!m_geodesic_domain || m_geodesic_domain->GetNumOfVerts() == 0)
+	{
+		cerr << "error in " << __FUNCTION__ << ", geodesic domain not loaded, input to exit" << endl;
+		getchar(); getchar(); getchar(); // dsy
+		exit(-1);
+	}
+	const CRichModel & model = *m_geodesic_domain;
+	// vertex of every point, once
+	vector<int> verts(num);
+	for (int i = 0; i < num; i++)
+	{
+		verts[i] = findVertex(model, points[i]);
+		if (verts[i] == -1)
+		{
+			cerr << "point: " << points[i].x() << " " << points[i].y() << endl;
+			cerr << "error in " << __FUNCTION__ << ", vertex can't find, input to exit" << endl;
+			getchar(); getchar(); getchar(); // dsy
+			exit(-1);
+		}
+	}
+	// row i holds d(i, j) for j > i, rows run concurrently and write disjoint cells
+	pool.parallel_for(num - 1, [&](int i, int worker) {
+		set<int> destinations;
+		for (int j = i + 1; j < num; j++)
+			if (verts[j] != verts[i])
+				destinations.insert(verts[j]);
+		if (destinations.empty())
+			return;
+		set<int> sources;
+		sources.insert(verts[i]);
+		CXin_Wang alg(model, sources, destinations);
+		alg.Execute();
+		const vector<double> & field = alg.GetDistanceField();
+		for (int j = i + 1; j < num; j++)
+			matrix[i][j] = verts[j] == verts[i] ? 0 : field[verts[j]];
+	});
+	// mirror
+	for (int i = 0; i < num; i++)
+		for (int j = i + 1; j < num; j++)
+			matrix[j][i] = matrix[i][j];
+	return matrix;
+}
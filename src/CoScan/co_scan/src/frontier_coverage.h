@@ -0,0 +1,118 @@
+#pragma once
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+// other headers
+#include "global.h"					// global variables
+#include "data_engine.h"			// scene reconstruction
+
+using namespace std;
+
+// frontier sets as bits, bit i = frontier i
+typedef vector<uint64_t> FrontierBits;
+
+// covered frontiers of views. frontiers are bit positions, a view covers the frontiers
+// inside its frustum that a shadow casting sweep from the view origin reaches.
+class FrontierCoverage
+{
+public:
+	int frontier_num = 0;
+	int words = 0; // uint64 per bitset
+
+	// index frontier cells (x = col, y = row), once per round
+	void build(DataEngine* p_de, const vector<cv::Point> & frontier_cells)
+	{
+		m_p_de = p_de;
+		frontier_num = frontier_cells.size();
+		words = (frontier_num + 63) / 64;
+		m_cells.clear();
+		for (int i = 0; i < frontier_num; i++)
+			m_cells.push_back(make_pair(key(frontier_cells[i]), i));
+		sort(m_cells.begin(), m_cells.end());
+	}
+
+	// frontiers covered by the frustum triangle (origin, left, right), strictly inside like
+	// pointPolygonTest > 0. rays from the origin to the far edge, half a cell apart, stop
+	// after the first unknown or occupied cell: a blocked frontier cell is still seen.
+	void cover(const vector<cv::Point> & frustum, FrontierBits & bits) const
+	{
+		bits.assign(words, 0);
+		if (frustum.size() < 3 || frontier_num == 0)
+			return;
+		cv::Point o = frustum[0], a = frustum[1], b = frustum[2];
+		int samples = 2 * max(abs(b.x - a.x), abs(b.y - a.y)) + 1;
+		for (int s = 0; s <= samples; s++)
+		{
+			double tx = a.x + (double)(b.x - a.x) * s / samples;
+			double ty = a.y + (double)(b.y - a.y) * s / samples;
+			double dx = tx - o.x, dy = ty - o.y;
+			int max_step = (int)ceil(max(fabs(dx), fabs(dy)));
+			if (max_step == 0)
+				continue;
+			double ux = dx / max_step, uy = dy / max_step;
+			double x = o.x, y = o.y;
+			for (int i = 1; i <= max_step; i++)
+			{
+				x += ux;
+				y += uy;
+				cv::Point p((int)round(x), (int)round(y));
+				if (p.x < 0 || p.y < 0 || p.x >= map_cols || p.y >= map_rows)
+					break;
+				if (inside(frustum, p))
+					mark(p, bits);
+				if (!(m_p_de->m_recon2D.m_cellmap[p.y][p.x].isScanned && m_p_de->m_recon2D.m_cellmap[p.y][p.x].isFree))
+					break;
+			}
+		}
+	}
+
+	static void set(FrontierBits & bits, int i) { bits[i >> 6] |= 1ULL << (i & 63); }
+
+	static bool test(const FrontierBits & bits, int i) { return (bits[i >> 6] >> (i & 63)) & 1; }
+
+	// |bits & ~mask|
+	static int count_new(const FrontierBits & bits, const FrontierBits & mask)
+	{
+		int n = 0;
+		for (int w = 0; w < bits.size(); w++)
+			n += __builtin_popcountll(bits[w] & ~mask[w]);
+		return n;
+	}
+
+	// mask |= bits
+	static void merge(FrontierBits & mask, const FrontierBits & bits)
+	{
+		for (int w = 0; w < mask.size(); w++)
+			mask[w] |= bits[w];
+	}
+
+private:
+	DataEngine* m_p_de = NULL;
+	vector<pair<long long, int>> m_cells; // (cell key, frontier), sorted
+
+	static long long key(cv::Point p) { return (long long)p.y * map_cols + p.x; }
+
+	// set the bits of the frontiers in cell p
+	void mark(cv::Point p, FrontierBits & bits) const
+	{
+		long long k = key(p);
+		auto it = lower_bound(m_cells.begin(), m_cells.end(), make_pair(k, -1));
+		for (; it != m_cells.end() && it->first == k; it++)
+			set(bits, it->second);
+	}
+
+	// strictly inside the triangle
+	static bool inside(const vector<cv::Point> & t, cv::Point p)
+	{
+		long long d0 = cross(t[0], t[1], p), d1 = cross(t[1], t[2], p), d2 = cross(t[2], t[0], p);
+		return (d0 > 0 && d1 > 0 && d2 > 0) || (d0 < 0 && d1 < 0 && d2 < 0);
+	}
+
+	static long long cross(cv::Point a, cv::Point b, cv::Point p)
+	{
+		return (long long)(b.x - a.x) * (p.y - a.y) - (long long)(b.y - a.y) * (p.x - a.x);
+	}
+};
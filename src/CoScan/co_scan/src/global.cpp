@@ -16,4 +16,8 @@ float g_camera_height = 1.1; // meter.
 
 int g_plan_iteration = 0;
 
+std::string g_tsp_log_path;
+
+int g_vis_level = 2; // VIS_FULL
+
 std::vector<cv::Point> g_scene_boundary;
\ No newline at end of file
@@ -56,6 +56,12 @@ extern float g_camera_height; // meter.
 
 extern int g_plan_iteration;
 
+// tsp instances are appended here when set, see tsp_bench.
+extern std::string g_tsp_log_path;
+
+// debug images up to this VisLevel, see vis_sink.h
+extern int g_vis_level;
+
 
 // opencv
 #include <opencv2/opencv.hpp>
@@ -17,7 +17,7 @@ void Navigation::processCurrentScene()
 	// current scene boundary...
 	{
 		// boundary
-		cv::Mat map_mat = m_p_de->visCellMap();
+		cv::Mat map_mat = m_p_de->visCellMapCached(); // read only
 		// find boundary
 		cv::Mat binary_mat(map_rows, map_cols, CV_8UC1);
 		for (int i = 0; i < binary_mat.rows; i++)
@@ -45,9 +45,7 @@ void Navigation::processCurrentScene()
 		cv::erode(bd_bin_mat, bd_bin_mat, cv::getStructuringElement(0, cv::Size(3, 3))); // erode. 
 		cv::erode(bd_bin_mat, bd_bin_mat, cv::getStructuringElement(0, cv::Size(3, 3))); // erode. 
 		// contours
-		vector<vector<cv::Point>> bd_contours;
 		vector<vector<cv::Point>> dilate_contours_0;
-		cv::findContours(binary_mat, bd_contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE);
 		cv::findContours(bd_bin_mat, dilate_contours_0, CV_RETR_LIST, CV_CHAIN_APPROX_NONE); 
 		// find biggest contour 
 		int dc_max_size_0 = 0;
@@ -62,7 +60,8 @@ void Navigation::processCurrentScene()
 		}
 		// save boundary
 		m_boundary.clear();
-		m_boundary = dilate_contours_0[dc_max_index_0];
+		for (int i = 0; i < dilate_contours_0[dc_max_index_0].size(); i++)
+			m_boundary.push_back(cv::Point2f(dilate_contours_0[dc_max_index_0][i].x, dilate_contours_0[dc_max_index_0][i].y));
 /*
 		// draw contours
         cv::Mat pc_resultImage = cv::Mat::zeros(map_rows, map_cols, CV_8U);
@@ -70,80 +69,54 @@ void Navigation::processCurrentScene()
         cv::imshow("contours", pc_resultImage);
         cv::waitKey(0);
 //*/
-		// find biggest contour (origin boundary to detect frontiers)
-		int c_max_size = 0;
-		int c_max_index = 0;
-		{
-			for (int i = 0; i < bd_contours.size(); i++)
-			{
-				if (bd_contours[i].size()>c_max_size){
-					c_max_size = bd_contours[i].size();
-					c_max_index = i;
-				}
-			}
-		}
-		
 		// frontiers
 		{
 			vector<cv::Point> samples_exploration; // samples of frontiers_exploration
 			vector<cv::Point> all_exploration; // all of frontiers_exploration
 			{
-				// frontier mat
-				cv::Mat frontier_mat = cv::Mat::zeros(map_rows, map_cols, CV_8UC1); // mat use to compute frontiers for exploration
-				// all frontiers for exploration
-				for (int contour_id = 0; contour_id < bd_contours.size(); contour_id++)
+				// all frontiers for exploration, only changed regions recomputed
+				updateFrontierCells();
+				for (auto it = m_frontier_cells.begin(); it != m_frontier_cells.end(); it++)
+					all_exploration.push_back(cv::Point(*it % map_cols, *it / map_cols));
+				// samples bucketed in a grid of the sample range, a closer sample can only be in the 3x3 buckets around
+				const int range = frontier_exploration_sample_range_pixel;
+				const int grid_rows = map_rows / range + 1;
+				const int grid_cols = map_cols / range + 1;
+				vector<vector<int>> buckets(grid_rows * grid_cols); // indexes in samples_exploration
+				for (int i = 0; i < all_exploration.size(); i++) // sampling
 				{
-					if (bd_contours[contour_id].size() <= 4)
-						continue;
-					for (int i = 0; i < bd_contours[contour_id].size(); i++)
+					Eigen::Vector2f pf(all_exploration[i].x, all_exploration[i].y);
+					int gr = all_exploration[i].y / range;
+					int gc = all_exploration[i].x / range;
+					// distance from the closest frontier sample
+					double min_dis = DBL_MAX;
+					for (int r = max(gr - 1, 0); r <= min(gr + 1, grid_rows - 1); r++)
 					{
-						if (m_p_de->m_recon2D.m_cellmap[bd_contours[contour_id][i].y][bd_contours[contour_id][i].x].isScanned && m_p_de->m_recon2D.m_cellmap[bd_contours[contour_id][i].y][bd_contours[contour_id][i].x].isFree)
-						{ // 修改后: 筛选一些
-							bool is_frontier = true;
-							for (int r = -1; r <= 1; r++)
+						for (int c = max(gc - 1, 0); c <= min(gc + 1, grid_cols - 1); c++)
+						{
+							const vector<int> & bucket = buckets[r * grid_cols + c];
+							for (int k = 0; k < bucket.size(); k++)
 							{
-								for (int c = -1; c <= 1; c++)
-								{
-									if (m_p_de->m_recon2D.m_cellmap[bd_contours[contour_id][i].y + r][bd_contours[contour_id][i].x + c].isScanned && m_p_de->m_recon2D.m_cellmap[bd_contours[contour_id][i].y + r][bd_contours[contour_id][i].x + c].isOccupied)
-									{
-										is_frontier = false;
-										break;
-									}
-								}
+								Eigen::Vector2f pt(samples_exploration[bucket[k]].x, samples_exploration[bucket[k]].y);
+								double crt_dis = (pf - pt).norm();
+								if (crt_dis < min_dis)
+									min_dis = crt_dis;
 							}
-							if (is_frontier)
-								frontier_mat.ptr<uchar>(bd_contours[contour_id][i].y)[bd_contours[contour_id][i].x] = 255;
 						}
 					}
-				}
-				// distance sample
-				for (int r = 0; r < map_rows; r++)
-					for (int c = 0; c < map_cols; c++)
-						if (frontier_mat.ptr<uchar>(r)[c] == 255)
-							all_exploration.push_back(cv::Point(c, r));
-				for (int i = 0; i < all_exploration.size(); i++) // sampling
-				{
-					// distance 
-					double min_dis = DBL_MAX;
-					for (int tid = 0; tid < samples_exploration.size(); tid++) // compute distance from the closest frontier sample
-					{
-						Eigen::Vector2f pf(all_exploration[i].x, all_exploration[i].y);
-						Eigen::Vector2f pt(samples_exploration[tid].x, samples_exploration[tid].y);
-						double crt_dis = (pf - pt).norm();
-						if (__isnan(crt_dis) != 0)
-							crt_dis = 0;
-						if (crt_dis < min_dis)
-							min_dis = crt_dis;
-					}
 					// filter based on distance
-					if (min_dis > frontier_exploration_sample_range_pixel) //10 pixel = 0.5m, 20 initial
+					if (min_dis > range) //10 pixel = 0.5m, 20 initial
+					{
+						buckets[gr * grid_cols + gc].push_back(samples_exploration.size());
 						samples_exploration.push_back(cv::Point(all_exploration[i].x, all_exploration[i].y));
+					}
 				}
 			}
-			// save of all exploration
-			int ft_num = all_exploration.size();
+			// save samples, frontier_exploration_sample_range_pixel apart
+			int ft_num = samples_exploration.size();
 			m_frontiers.clear();
-			m_frontiers = all_exploration;
+			m_frontiers = samples_exploration;
+			cerr << "frontier cells " << all_exploration.size() << ", samples " << ft_num << endl;
 			if (ft_num == 0)
 			{
 				cerr << "no frontier." << endl;
@@ -192,9 +165,13 @@ void Navigation::processCurrentScene()
 								for (int r = min_y; r <= max_y; r++)
 									for (int c = min_x; c <= max_x; c++)
 										bin_map.ptr<uchar>(r)[c] = 0;
-								char pth[100];
-								sprintf(pth, "result/obstical_%d.png", g_plan_iteration);
-								cv::imwrite(pth, bin_map);
+								if (m_vis.enabled(VIS_FULL))
+								{
+									char pth[100];
+									sprintf(pth, "result/obstical_%d.png", g_plan_iteration);
+									cv::Mat dump = bin_map.clone();
+									m_vis.post(VIS_FULL, pth, [dump]() { return dump; });
+								}
 							}
 							else
 							{
@@ -205,9 +182,13 @@ void Navigation::processCurrentScene()
 								for (int r = min_y; r <= max_y; r++)
 									for (int c = min_x; c <= max_x; c++)
 										bin_map.ptr<uchar>(r)[c] = 0;
-								char pth[100];
-								sprintf(pth, "result/obstical_%d.png", g_plan_iteration);
-								cv::imwrite(pth, bin_map);
+								if (m_vis.enabled(VIS_FULL))
+								{
+									char pth[100];
+									sprintf(pth, "result/obstical_%d.png", g_plan_iteration);
+									cv::Mat dump = bin_map.clone();
+									m_vis.post(VIS_FULL, pth, [dump]() { return dump; });
+								}
 							}
 						}
 						else
@@ -260,62 +241,9 @@ void Navigation::processCurrentScene()
 					cv::imwrite(pth, bin_map);
 				}
 //*/
-				// contours
-				vector<vector<cv::Point>> contours;
-				vector<cv::Vec4i> hierarchy;
-				cv::findContours(bin_map, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_NONE); // tree
-				// filter hole in hole
-				vector<int> dlt_idx;
-				for (int i = 0; i < hierarchy.size(); i++)
-				{
-					if (hierarchy[i][3] != -1)
-						dlt_idx.push_back(i);
-				}
-				// delete hole in hole
-				if (dlt_idx.size() > 0){
-					for (int i = dlt_idx.size() - 1; i >= 0; i--)
-					{
-						//cout << "i: " << i << endl;
-						auto it = contours.begin() + dlt_idx[i];
-						contours.erase(it);
-					}
-				}
-		/*
-				// 判断是否只有一个大边界 hole
-				if (contours.size() == 1)
-				{ // 判断是否是墙组成的大边界
-					int min_x = col, min_y = row;
-					int max_x = 0, max_y = 0;
-					for (int i = 0; i < contours[0].size(); i++)
-					{
-						if (contours[0][i].x < min_x)
-							min_x = contours[0][i].x;
-						if (contours[0][i].x > max_x)
-							max_x = contours[0][i].x;
-						if (contours[0][i].y < min_y)
-							min_y = contours[0][i].y;
-						if (contours[0][i].y > max_y)
-							max_y = contours[0][i].y;
-					}
-					if (max_y - min_y >= 190 && max_x - min_x >= 90)
-					{ // todo: 如果是,把四周的墙都去掉一块把墙分开
-						
-					}
-				}
-		//*/
-				// check hole[i] size, remove which size<3. 2018-10-16
-				{
-					vector<int> deleteIndexes;
-					for (int hid = 0; hid < contours.size(); hid++)
-						if (contours[hid].size() < 3) // if contour size < 3, it cant be operated as polygon. on the other hand this contour is trival.
-							deleteIndexes.push_back(hid);
-					if (!deleteIndexes.empty())
-						for (int i = deleteIndexes.size() - 1; i >= 0; i--)
-							contours.erase(contours.begin() + deleteIndexes[i]);
-				}
-				// save
-				m_holes.clear();
-				m_holes = contours;
+				// boundary and holes in one pass, touching holes merged, holes touching the boundary cut into it
+				if (!extractDomain(bin_map))
+					cerr << "error, no free domain" << endl;
 			}
 		}
 	}
@@ -323,6 +251,114 @@ void Navigation::processCurrentScene()
 	return;
 }
 
+// boundary and holes from the free cells inside the boundary contour.
+bool Navigation::extractDomain(const cv::Mat & obstacle_mat)
+{
+	m_domain_disjoint = false;
+	m_holes.clear();
+	// free domain: inside the boundary contour, off the offset obstacles
+	cv::Mat domain = cv::Mat::zeros(map_rows, map_cols, CV_8UC1);
+	{
+		vector<vector<cv::Point>> outer(1);
+		for (int i = 0; i < m_boundary.size(); i++)
+			outer[0].push_back(cv::Point(round(m_boundary[i].x), round(m_boundary[i].y)));
+		cv::fillPoly(domain, outer, cv::Scalar(255));
+	}
+	domain.setTo(0, obstacle_mat);
+	// largest 4-connected piece without corner pinches. cutting a pinch may split the piece, so repeat
+	bool changed = true;
+	while (changed)
+	{
+		cv::Mat labels, stats, centroids;
+		int num = cv::connectedComponentsWithStats(domain, labels, stats, centroids, 4);
+		if (num < 2)
+			return false;
+		int best = 1;
+		for (int l = 2; l < num; l++)
+			if (stats.at<int>(l, cv::CC_STAT_AREA) > stats.at<int>(best, cv::CC_STAT_AREA))
+				best = l;
+		domain = labels == best;
+		// free cells touching by a corner only would pass one corner twice. drop one of them
+		changed = false;
+		for (int i = 0; i + 1 < map_rows; i++)
+		{
+			uchar* r0 = domain.ptr<uchar>(i);
+			uchar* r1 = domain.ptr<uchar>(i + 1);
+			for (int j = 0; j + 1 < map_cols; j++)
+			{
+				if ((r0[j] != 0) == (r1[j + 1] != 0) && (r0[j + 1] != 0) == (r1[j] != 0) && (r0[j] != 0) != (r0[j + 1] != 0))
+				{
+					if (r0[j]) r0[j] = 0;
+					else r0[j + 1] = 0;
+					changed = true;
+				}
+			}
+		}
+	}
+	// directed cell edges between free and other cells, free on the same side. one edge out of each corner
+	const int w = map_cols + 1;
+	vector<int> next((size_t)w * (map_rows + 1), -1);
+	for (int i = 0; i < map_rows; i++)
+	{
+		const uchar* row = domain.ptr<uchar>(i);
+		for (int j = 0; j < map_cols; j++)
+		{
+			if (!row[j])
+				continue;
+			if (i == 0 || !domain.ptr<uchar>(i - 1)[j]) // top
+				next[i * w + j + 1] = i * w + j;
+			if (j == 0 || !row[j - 1]) // left
+				next[i * w + j] = (i + 1) * w + j;
+			if (i + 1 == map_rows || !domain.ptr<uchar>(i + 1)[j]) // bottom
+				next[(i + 1) * w + j] = (i + 1) * w + j + 1;
+			if (j + 1 == map_cols || !row[j + 1]) // right
+				next[(i + 1) * w + j + 1] = i * w + j + 1;
+		}
+	}
+	// loops, corners where the direction turns
+	vector<vector<cv::Point2f>> loops;
+	int outer = -1;
+	double outer_area = 0;
+	vector<int> corners;
+	for (int s = 0; s < next.size(); s++)
+	{
+		if (next[s] < 0)
+			continue;
+		corners.clear();
+		for (int v = s; next[v] >= 0;)
+		{
+			corners.push_back(v);
+			int u = next[v];
+			next[v] = -1;
+			v = u;
+		}
+		vector<cv::Point2f> loop;
+		int n = corners.size();
+		for (int k = 0; k < n; k++)
+		{
+			int a = corners[(k + n - 1) % n], b = corners[k], c = corners[(k + 1) % n];
+			if (b - a != c - b)
+				loop.push_back(cv::Point2f(b % w - 0.5f, b / w - 0.5f)); // cell center coordinates
+		}
+		double area = 0;
+		for (int k = 0; k < loop.size(); k++)
+			area += loop[k].x * loop[(k + 1) % loop.size()].y - loop[(k + 1) % loop.size()].x * loop[k].y;
+		if (fabs(area) > outer_area)
+		{
+			outer_area = fabs(area);
+			outer = loops.size();
+		}
+		loops.push_back(loop);
+	}
+	// save. the outer loop encloses the others
+	m_boundary = loops[outer];
+	for (int l = 0; l < loops.size(); l++)
+		if (l != outer)
+			m_holes.push_back(loops[l]);
+	m_domain_disjoint = true;
+	return true;
+}
+
 // polygon simplification. reduce number of vertexes.
 bool Navigation::simplifyPolygon(Polygon_2 & poly, const double colinearThresh, bool addNoise)
 {
@@ -443,6 +479,38 @@ Pwh_list_2 Navigation::differenceCGALExactKernel(Polygon_with_holes_2 domain, Po
 	return res;
 }
 
+// joint simplification of boundary and holes.
+void Navigation::simplifyDomain(Polygon_2 & boundary, vector<Polygon_2> & holes)
+{
+	if (polygon_simplify_tolerance <= 0)
+		return;
+	// rings, cells
+	vector<vector<Eigen::Vector2d>> rings(holes.size() + 1);
+	int before = 0;
+	for (int r = 0; r < rings.size(); r++)
+	{
+		const Polygon_2 & poly = r == 0 ? boundary : holes[r - 1];
+		for (int i = 0; i < poly.size(); i++)
+			rings[r].push_back(Eigen::Vector2d(poly[i].x(), poly[i].y()));
+		before += poly.size();
+	}
+	DomainSimplifier simplifier;
+	simplifier.tolerance = polygon_simplify_tolerance;
+	simplifier.margin = offset_size;
+	simplifier.clearance = polygon_simplify_clearance;
+	int after = simplifier.simplify(rings);
+	// save
+	for (int r = 0; r < rings.size(); r++)
+	{
+		Polygon_2 & poly = r == 0 ? boundary : holes[r - 1];
+		poly.clear();
+		for (int i = 0; i < rings[r].size(); i++)
+			poly.push_back(Point_2(rings[r][i].x(), rings[r][i].y()));
+	}
+	cerr << "domain point number = " << before << " -> " << after << endl;
+	return;
+}
+
 // load and check boundary.
 Polygon_2 Navigation::load_and_check_boundary()
 {
@@ -518,6 +586,13 @@ vector<Polygon_2> Navigation::load_and_check_holes(Polygon_2 boundary, vector<Po
 		// 对于每个hole判断其边界是否自交
 		for (int hid = 0; hid < holes.size(); hid++)
 		{
+			if (m_domain_disjoint)
+			{
+				// traced loops are simple, orientation only
+				if (holes[hid].area() < 0)
+					holes[hid].reverse_orientation();
+				continue;
+			}
 			bool self_intersect = false;
 			vector<Point_2> points;
 			set<Point_2> test_points;
@@ -549,8 +624,8 @@ vector<Polygon_2> Navigation::load_and_check_holes(Polygon_2 boundary, vector<Po
 				holes[hid].reverse_orientation();
 		}
 	}
-	// simplify
-	for (int hid = 0; hid < holes.size(); hid++)
+	// simplify, traced loops have corners only and need no noise
+	for (int hid = 0; hid < holes.size() && !m_domain_disjoint; hid++)
 	{
 		simplifyPolygon(holes[hid], 0.1, true);
 	}
@@ -581,32 +656,46 @@ void Navigation::correct_boundary_holes(Polygon_2 & boundary, std::vector<Polygo
 	Pwh_list_2 results;
 	Polygon_with_holes_2 domain;
 	domain.outer_boundary() = boundary;
-	for (int hid = 0; hid < holes.size(); hid++)
-	{
-		// difference use exact kernel to avoid numerical error
-		results = differenceCGALExactKernel(domain, holes[hid]);
-		//cerr << "results(polygons) size = " << results.size() << endl;
-		//cerr << "outer boundary area = " << results.begin()->outer_boundary().area() << endl;
-		// update domain
-		if (results.size() != 1
-		){ // if domain become not continious
-			int max_size = 0;
-			for (auto i = results.begin(); i != results.end(); i++)
-				if (i->outer_boundary().size() > max_size)
-					max_size = i->outer_boundary().size();
-			for (auto i = results.begin(); i != results.end(); i++)
-			{
-				if (i->outer_boundary().size() == max_size)
+	if (m_domain_disjoint)
+	{
+		// traced holes are apart and inside the boundary, no difference needed
+		for (int hid = 0; hid < holes.size(); hid++)
+		{
+			Polygon_2 hole = holes[hid];
+			if (hole.area() > 0)
+				hole.reverse_orientation(); // clockwise like the difference results
+			domain.add_hole(hole);
+		}
+	}
+	else
+	{
+		for (int hid = 0; hid < holes.size(); hid++)
+		{
+			// difference use exact kernel to avoid numerical error
+			results = differenceCGALExactKernel(domain, holes[hid]);
+			//cerr << "results(polygons) size = " << results.size() << endl;
+			//cerr << "outer boundary area = " << results.begin()->outer_boundary().area() << endl;
+			// update domain
+			if (results.size() != 1
+			){ // if domain become not continious
+				int max_size = 0;
+				for (auto i = results.begin(); i != results.end(); i++)
+					if (i->outer_boundary().size() > max_size)
+						max_size = i->outer_boundary().size();
+				for (auto i = results.begin(); i != results.end(); i++)
 				{
-					domain = Polygon_with_holes_2(*i);
-					break;
+					if (i->outer_boundary().size() == max_size)
+					{
+						domain = Polygon_with_holes_2(*i);
+						break;
+					}
 				}
+				results.clear();
+				continue;
 			}
+			domain = Polygon_with_holes_2(*results.begin());
 			results.clear();
-			continue;
 		}
-		domain = Polygon_with_holes_2(*results.begin());
-		results.clear();
 	}
 	// reset boundary and holes
 	boundary.clear();
@@ -662,6 +751,8 @@ bool Navigation::robotMoveDomainProcess(Polygon_2 & boundary, vector<Polygon_2>
 	boundary = load_and_check_boundary();
 	// domain holes
 	holes = load_and_check_holes(boundary, origin_holes);
+	// fewer vertexes, same topology
+	simplifyDomain(boundary, holes);
 	// correction: compute domain and reset boundary & holes
 	correct_boundary_holes(boundary, holes); // by the difference of polygons
 	// end.
@@ -1005,6 +1096,8 @@ bool Navigation::generateMoveDomainCDT(Polygon_2 boundary, vector<Polygon_2> hol
 // load and check frontiers, saved in the variable frontiers
 vector<Point_2> Navigation::load_and_check_frontiers(Polygon_2 & boundary, vector<Polygon_2> & holes)
 {
+	// this round's frontiers only
+	m_frontiers_p2.clear();
 	for (int fid = 0; fid < m_frontiers.size(); ++fid)
 	{
 		m_frontiers_p2.push_back(Point_2(m_frontiers[fid].x, -m_frontiers[fid].y));
@@ -1034,25 +1127,35 @@ vector<int> Navigation::preprocess_frontiers(Polygon_2 outer, vector<Polygon_2>
 		}
 		holes.push_back(hole);
 	}
+	// forget old unreachable targets
+	task_maybe_invalid.expire(g_plan_iteration, invalid_task_max_age);
+	// rasterized regions, exact tests only near their edges
+	PolygonMask boundary_mask, holes_mask, scene_mask;
+	boundary_mask.build(vector<vector<cv::Point>>(1, boundary), (int)ceil(offset_size * 1.41) + 2);
+	holes_mask.build(holes, (int)ceil(offset_size * 1.41) + 2);
+	if (!g_scene_boundary.empty())
+		scene_mask.build(vector<vector<cv::Point>>(1, g_scene_boundary), 4);
 	// determine if the frontier is a task
 	for (int i = 0; i < m_frontiers_p2.size(); i++)
 	{
+		cv::Point cell(round(m_frontiers_p2[i].x()), -round(m_frontiers_p2[i].y()));
 		// check reachable
 		bool visible = true;
 		string err = "";
 		// voxels that cant scan
 		if (visible)
-			for (auto unvisible_task = task_maybe_invalid.begin(); unvisible_task != task_maybe_invalid.end(); unvisible_task++)
+			if (task_maybe_invalid.contains(m_frontiers_p2[i]))
 			{
-				if (fabs(m_frontiers_p2[i].x() - unvisible_task->x()) < 1 && fabs(m_frontiers_p2[i].y() - unvisible_task->y()) < 1)
-				{
-					visible = false;
-					err = "cant scan.";
-					break;
-				}
+				visible = false;
+				err = "cant scan.";
 			}
 		// voxels that out of boundary
-		if (visible)
+		if (visible && boundary_mask.at(cell) == PolygonMask::OUTSIDE)
+		{
+			visible = false;
+			err = "out of boundary.";
+		}
+		if (visible && boundary_mask.at(cell) == PolygonMask::NEAR_EDGE)
 			if (cv::pointPolygonTest(boundary, cv::Point(round(m_frontiers_p2[i].x()), -round(m_frontiers_p2[i].y())), false) < 0)
 			{
 				// if distance < offset_size, its may be valid.
@@ -1064,7 +1167,12 @@ vector<int> Navigation::preprocess_frontiers(Polygon_2 outer, vector<Polygon_2>
 				}
 			}
 		// voxels that in holes
-		if (visible)
+		if (visible && holes_mask.at(cell) == PolygonMask::INSIDE)
+		{
+			visible = false;
+			err = "in hole.";
+		}
+		if (visible && holes_mask.at(cell) == PolygonMask::NEAR_EDGE)
 			for (int hid = 0; hid < holes.size(); hid++)
 			{
 				if (cv::pointPolygonTest(holes[hid], cv::Point(round(m_frontiers_p2[i].x()), -round(m_frontiers_p2[i].y())), false) > 0)
@@ -1083,7 +1191,12 @@ vector<int> Navigation::preprocess_frontiers(Polygon_2 outer, vector<Polygon_2>
 				}
 			}
 		// voxels that out of scene boundary
-		if (visible)
+		if (visible && scene_mask.at(cell) == PolygonMask::OUTSIDE)
+		{
+			visible = false;
+			err = "out of scene_boundary.";
+		}
+		if (visible && scene_mask.at(cell) == PolygonMask::NEAR_EDGE)
 			if (!g_scene_boundary.empty()) // 20200311
 			{
 				//if (cv::pointPolygonTest(g_scene_boundary, cv::Point(round(m_frontiers_p2[i].x()), -round(m_frontiers_p2[i].y())), false) < 0)
@@ -1177,60 +1290,123 @@ vector<int> Navigation::preprocess_frontiers(Polygon_2 outer, vector<Polygon_2>
 	return indexes;
 }
 
+// frontier cells: scanned free cells next to unknown ones, without occupied cells around, off scanned specks.
+// a cell depends on cells up to frontier_min_region away, so cells that far past a changed region are recomputed too.
+void Navigation::updateFrontierCells()
+{
+	// at least frontier_min_region scanned cells 8-connected to (r, c), bounded flood fill
+	auto not_speck = [this](int r, int c)
+	{
+		vector<cv::Point> region(1, cv::Point(c, r));
+		for (int i = 0; i < region.size() && region.size() < frontier_min_region; i++)
+		{
+			for (int dr = -1; dr <= 1; dr++)
+			{
+				for (int dc = -1; dc <= 1; dc++)
+				{
+					cv::Point q(region[i].x + dc, region[i].y + dr);
+					if (q.x < 0 || q.y < 0 || q.x >= map_cols || q.y >= map_rows || !m_p_de->m_recon2D.m_cellmap[q.y][q.x].isScanned)
+						continue;
+					if (find(region.begin(), region.end(), q) == region.end())
+						region.push_back(q);
+				}
+			}
+		}
+		return region.size() >= frontier_min_region;
+	};
+	vector<cv::Rect> dirty = m_p_de->takeDirtyRects();
+	if (m_frontier_mask.empty())
+	{
+		// first round, whole map
+		m_frontier_mask = cv::Mat::zeros(map_rows, map_cols, CV_8UC1);
+		m_frontier_cells.clear();
+		dirty.assign(1, cv::Rect(0, 0, map_cols, map_rows));
+	}
+	const cv::Rect inner(1, 1, map_cols - 2, map_rows - 2); // cells with all neighbours in the map
+	for (int i = 0; i < dirty.size(); i++)
+	{
+		const int reach = frontier_min_region;
+		cv::Rect rect(dirty[i].x - reach, dirty[i].y - reach, dirty[i].width + 2 * reach, dirty[i].height + 2 * reach);
+		rect &= inner;
+		for (int r = rect.y; r < rect.y + rect.height; r++)
+		{
+			uchar* mask = m_frontier_mask.ptr<uchar>(r);
+			for (int c = rect.x; c < rect.x + rect.width; c++)
+			{
+				bool is_frontier = false;
+				if (m_p_de->m_recon2D.m_cellmap[r][c].isScanned && m_p_de->m_recon2D.m_cellmap[r][c].isFree)
+				{
+					bool near_unknown = !m_p_de->m_recon2D.m_cellmap[r - 1][c].isScanned || !m_p_de->m_recon2D.m_cellmap[r + 1][c].isScanned
+						|| !m_p_de->m_recon2D.m_cellmap[r][c - 1].isScanned || !m_p_de->m_recon2D.m_cellmap[r][c + 1].isScanned;
+					bool near_occupied = false;
+					for (int dr = -1; dr <= 1 && !near_occupied; dr++)
+						for (int dc = -1; dc <= 1; dc++)
+							if (m_p_de->m_recon2D.m_cellmap[r + dr][c + dc].isScanned && m_p_de->m_recon2D.m_cellmap[r + dr][c + dc].isOccupied)
+							{
+								near_occupied = true;
+								break;
+							}
+					is_frontier = near_unknown && !near_occupied && not_speck(r, c);
+				}
+				if (is_frontier && mask[c] == 0)
+				{
+					mask[c] = 255;
+					m_frontier_cells.insert(r * map_cols + c);
+				}
+				else if (!is_frontier && mask[c] != 0)
+				{
+					mask[c] = 0;
+					m_frontier_cells.erase(r * map_cols + c);
+				}
+			}
+		}
+	}
+}
+
 // compute location map
+// clearance score of free cells, 10 per erosion by the 2kernelR box they survive, up to thresh erosions.
+// one distance transform instead of thresh erosions, cached until the map changes.
 cv::Mat Navigation::computeLoationMap()
 {
+	if (!m_location_map.empty() && m_location_map_version == m_p_de->m_map_version)
+		return m_location_map;
 	// set up
 	const int thresh = 30;
 	const int kernelR = 3;
-	// input
-	cv::Mat img = m_p_de->visCellMap();
+	const float shrink = kernelR - 0.5f; // free space lost per side by one erosion, on average
 	// free space
-	cv::Mat freeSpaces = cv::Mat::zeros(img.rows, img.cols, CV_8UC1);
-	for (int r = 0; r < img.rows; r++)
+	cv::Mat freeSpaces = m_p_de->freeMask();
+	cv::Mat dist; // CV_32F
+	cv::distanceTransform(freeSpaces, dist, cv::DIST_L2, 3);
+	// location map
+	cv::Mat LocationMap = cv::Mat::zeros(freeSpaces.rows, freeSpaces.cols, CV_8UC1);
+	for (int r = 0; r < LocationMap.rows; r++)
 	{
-		for (int c = 0; c < img.cols; c++)
+		const float* d = dist.ptr<float>(r);
+		uchar* score = LocationMap.ptr<uchar>(r);
+		for (int c = 0; c < LocationMap.cols; c++)
 		{
-			if (img.ptr<cv::Vec3b>(r)[c][1] == 255)
-				freeSpaces.ptr<uchar>(r)[c] = 10;
+			if (d[c] <= 0)
+				continue;
+			int steps = min(thresh, (int)((d[c] - 1) / shrink));
+			score[c] = cv::saturate_cast<uchar>(10 * (1 + steps));
 		}
 	}
-	// location map
-	cv::Mat LocationMap = cv::Mat::zeros(img.rows, img.cols, CV_8UC1);
-	LocationMap += freeSpaces;
-	// computing
-	for (int step = 0; step < thresh; step++)
-	{
-		cv::erode(freeSpaces, freeSpaces, cv::getStructuringElement(0, cv::Size(kernelR * 2, kernelR * 2)));
-		LocationMap += freeSpaces;
-	}
-	return LocationMap;
+	m_location_map = LocationMap;
+	m_location_map_version = m_p_de->m_map_version;
+	return m_location_map;
 }
 
 // check view ray validness(without occlusion) 2018-09-12. not finish
 bool Navigation::checkViewRayValidness(cv::Point source, cv::Point target)
 {
 	// set up
-	const int invalidValue = 255;
 	cv::Point beg(source);
 	cv::Point end(target);
-	cv::Mat domain = cv::Mat::zeros(map_rows, map_cols, CV_8UC1);
-	for (int r = 0; r < domain.rows; r++)
-	{
-		for (int c = 0; c < domain.cols; c++)
-		{
-			// not allow view through unknown
-			if (m_p_de->m_recon2D.m_cellmap[r][c].isScanned && m_p_de->m_recon2D.m_cellmap[r][c].isFree)
-			{
-				// free spaces value '0' 
-			}
-			else
-			{
-				// unknown and occupied spaces value 'invalidValue'
-				domain.ptr<uchar>(r)[c] = invalidValue;
-			}
-		}
-	}
+	// not allow view through unknown: unknown and occupied cells block the ray. read only, safe to call concurrently
+	auto blocked = [this](int r, int c) {
+		return !(m_p_de->m_recon2D.m_cellmap[r][c].isScanned && m_p_de->m_recon2D.m_cellmap[r][c].isFree);
+	};
 	// DDA
 	bool occlusion = false;
 	int dx = end.x - beg.x;
@@ -1240,7 +1416,7 @@ bool Navigation::checkViewRayValidness(cv::Point source, cv::Point target)
 		int beg_y = beg.y < end.y ? beg.y : end.y;
 		int end_y = beg.y > end.y ? beg.y : end.y;
 		for (int y = beg_y; y < end_y; y++)
-			if (domain.ptr<uchar>(y)[beg.x] == invalidValue)
+			if (blocked(y, beg.x))
 			{
 				occlusion = true;
 				break;
@@ -1251,7 +1427,7 @@ bool Navigation::checkViewRayValidness(cv::Point source, cv::Point target)
 		int beg_x = beg.x < end.x ? beg.x : end.x;
 		int end_x = beg.x > end.x ? beg.x : end.x;
 		for (int x = beg_x; x < end_x; x++)
-			if (domain.ptr<uchar>(beg.y)[x] == invalidValue)
+			if (blocked(beg.y, x))
 			{
 				occlusion = true;
 				break;
@@ -1272,7 +1448,7 @@ bool Navigation::checkViewRayValidness(cv::Point source, cv::Point target)
 		{
 			x = x + fXUnitLen;
 			y = y + fYUnitLen;
-			if (domain.ptr<uchar>((int)round(y))[(int)round(x)] == invalidValue)
+			if (blocked((int)round(y), (int)round(x)))
 			{
 				occlusion = true;
 				break;
@@ -1342,178 +1518,143 @@ vector<cv::Point> Navigation::get_frustum_contuor(iro::SE2 pose)
 // NBV for frontiers
 vector<NextBestView> Navigation::generateViewsFrontiers(bool enableSampling, double sampleRate)
 {
-	// if srand
-	srand((unsigned)time(NULL)); 
+	// seed of this round, every frontier draws from its own stream of it
+	unsigned int seed = view_random_seed != 0 ? view_random_seed + g_plan_iteration : (unsigned int)time(NULL);
 	// set up
 	vector<NextBestView> nbvs;
 	vector<FrontierElement> frontier_list;
-	for (int i = 0; i < m_frontierList.size(); i++)
 	{
-		if (enableSampling)
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> uniform(0, 1);
+		for (int i = 0; i < m_frontierList.size(); i++)
 		{
-			if ((double)rand() / RAND_MAX < sampleRate)
-			{
+			if (!enableSampling || uniform(rng) < sampleRate)
 				frontier_list.push_back(m_frontierList[i]);
-			}
-		}
-		else
-		{
-			frontier_list.push_back(m_frontierList[i]);
 		}
 	}
 
 	// test record sampled frontier
+	if (m_vis.enabled(VIS_FULL))
 	{
-		cv::Mat statement = m_p_de->visCellMap();
-		cv::Mat temp = statement.clone();
-		// draw frontiers in list
+		// copies for the sink thread
+		cv::Mat statement = m_p_de->visCellMapCached();
+		vector<cv::Point> listed, sampled, invalid;
 		for (int fid = 0; fid < m_frontierList.size(); fid++)
-		{
-			int x = m_frontierList[fid].position.x();
-			int y = -m_frontierList[fid].position.y();
-			cv::circle(temp, cv::Point(x, y), 0, CV_RGB(255, 255, 255));
-			cv::circle(temp, cv::Point(x, y), 1, CV_RGB(255, 255, 255));
-			cv::circle(temp, cv::Point(x, y), 2, CV_RGB(255, 255, 255));
-		}
-		// draw sampled frontiers 
+			listed.push_back(cv::Point((int)m_frontierList[fid].position.x(), -(int)m_frontierList[fid].position.y()));
 		for (int fid = 0; fid < frontier_list.size(); fid++)
-		{
-			int x = frontier_list[fid].position.x();
-			int y = -frontier_list[fid].position.y();
-			cv::circle(temp, cv::Point(x, y), 1, CV_RGB(255, 0, 255));
-		}
-		// draw invalid frontiers
-		for (auto it = task_maybe_invalid.begin(); it != task_maybe_invalid.end(); it++)
-		{
-			int x = it->x();
-		 	int y = -it->y();
-		 	cv::circle(temp, cv::Point(x, y), 1, CV_RGB(0, 255, 255));
-		}
-		// for (int fid = 0; fid < task_maybe_invalid.size(); fid++)
-		// {
-		// 	int x = task_maybe_invalid[fid].x();
-		// 	int y = -task_maybe_invalid[fid].y();
-		// 	cv::circle(temp, cv::Point(x, y), 1, CV_RGB(0, 255, 255));
-		// }
-		// save file
+			sampled.push_back(cv::Point((int)frontier_list[fid].position.x(), -(int)frontier_list[fid].position.y()));
+		task_maybe_invalid.for_each([&invalid](const Point_2 & p) {
+			invalid.push_back(cv::Point((int)p.x(), -(int)p.y()));
+		});
 		char output_path[200];
 		sprintf(output_path, "result/sampled_frontier_%d.png", g_plan_iteration);
-		cv::imwrite(output_path, temp);
+		m_vis.post(VIS_FULL, output_path, [statement, listed, sampled, invalid]()
+		{
+			cv::Mat temp = statement.clone();
+			// draw frontiers in list
+			for (int fid = 0; fid < listed.size(); fid++)
+			{
+				cv::circle(temp, listed[fid], 0, CV_RGB(255, 255, 255));
+				cv::circle(temp, listed[fid], 1, CV_RGB(255, 255, 255));
+				cv::circle(temp, listed[fid], 2, CV_RGB(255, 255, 255));
+			}
+			// draw sampled frontiers
+			for (int fid = 0; fid < sampled.size(); fid++)
+				cv::circle(temp, sampled[fid], 1, CV_RGB(255, 0, 255));
+			// draw invalid frontiers
+			for (int fid = 0; fid < invalid.size(); fid++)
+				cv::circle(temp, invalid[fid], 1, CV_RGB(0, 255, 255));
+			return temp;
+		});
 	}
 
 	cv::Mat locaMap = computeLoationMap(); // known region structure
-	// generate NBVs
-	while (!frontier_list.empty())
-	{
-		FrontierElement current_frontier = frontier_list.front();
-		cv::Point fp(current_frontier.position.x(), -current_frontier.position.y());
-		vector<cv::Point> vps;
+	// best view position of every frontier, concurrently. x = -1 if none
+	int frt_num = frontier_list.size();
+	vector<cv::Point> best_views(frt_num, cv::Point(-1, -1));
+	vector<double> jitters(frt_num, 0); // offsets of invalid frontiers in task_maybe_invalid
+	FreeCellIndex free_cells; // view candidates
+	free_cells.build(m_p_de);
+	vector<vector<cv::Point>> buffers(m_pool.size()); // candidate positions, one buffer per worker
+	m_pool.parallel_for(frt_num, [&](int fid, int worker) {
+		// stream of this frontier, same draws for any thread count
+		std::seed_seq seq{ seed, (unsigned int)fid };
+		std::mt19937 rng(seq);
+		std::uniform_real_distribution<double> uniform(0, 1);
+		cv::Point fp(frontier_list[fid].position.x(), -frontier_list[fid].position.y());
+		vector<cv::Point> & vps = buffers[worker];
 		const int rangeMIN = 10; // pixel
 		const int rangeMAX = 40; // pixel
-		int delta = rangeMAX;
-		int beg_r = fp.y - delta < 0 ? 0 : fp.y - delta;
-		int end_r = fp.y + delta > map_rows - 1 ? map_rows - 1 : fp.y + delta;
-		int beg_c = fp.x - delta < 0 ? 0 : fp.x - delta;
-		int end_c = fp.x + delta > map_cols - 1 ? map_cols - 1 : fp.x + delta;
-		for (int r = beg_r; r <= end_r; r++)
-		{
-			for (int c = beg_c; c <= end_c; c++)
-			{
-				//cv::circle(visual, cv::Point(c, r), 2, CV_RGB(0, 255, 0)); // test
-				if (m_p_de->m_recon2D.m_cellmap[r][c].isScanned && m_p_de->m_recon2D.m_cellmap[r][c].isFree) // valid position in domain
-				{
-					if ((double)rand() / RAND_MAX < 0.995)	// random sample, 0.9 is ok but not efficient. 
-						continue;						
-					double eDistance = m_metric.get_euclidean_distance(cv::Point(c, r), fp);
-					if (eDistance > rangeMIN) // outside min of scan range
-					{
-						if (checkViewRayValidness(cv::Point(c, r), fp))
-						{
-							//cv::circle(visual, cv::Point(c, r), 2, CV_RGB(255, 0, 255)); // test
-							vps.push_back(cv::Point(c, r));
-						}
-					}
-				}
-			}
-		}
-		// sample
-		const int numMax = 10;
-		if (vps.size() > numMax)
-		{
-			int num = vps.size() - numMax;
-			for (int i = 0; i < num; i++)
-			{
-				int idx = (int)floor(rand() % (vps.size() - 1));
-				vps.erase(vps.begin() + idx);
-			}
-		}
-		// score these candidate positions
-		vector<double> scores;
-		scores.resize(vps.size());
-		for (int idx = 0; idx < scores.size(); idx++)
-		{
-			scores[idx] = locaMap.ptr<uchar>(vps[idx].y)[vps[idx].x];
-		}
+		const int numMax = 10; // candidates
+		const int maxChecks = 4 * numMax; // ray checks
+		free_cells.sample(fp, rangeMIN, rangeMAX, numMax, maxChecks, rng,
+			[&](cv::Point p) { return checkViewRayValidness(p, fp); }, vps);
+		// select the best by location score
 		double max_score = -1;
-		double max_index = -1;
-		for (int idx = 0; idx < vps.size(); idx++) // select the best
+		int max_index = -1;
+		for (int idx = 0; idx < vps.size(); idx++)
 		{
-			if (max_score < scores[idx])
+			double score = locaMap.ptr<uchar>(vps[idx].y)[vps[idx].x];
+			if (max_score < score)
 			{
-				max_score = scores[idx];
+				max_score = score;
 				max_index = idx;
 			}
 		}
-		// valid check
-		if (max_index == -1)
-		{
-			task_maybe_invalid.insert(Point_2(frontier_list.begin()->position.x() + (double)rand() / RAND_MAX / 10, frontier_list.begin()->position.y()));
-			frontier_list.erase(frontier_list.begin());
-			//cout << "no valid views, continue to next frontier..." << endl;
-			continue;
-		}
-		//cerr<<"task_maybe_invalid.size() = "<<task_maybe_invalid.size()<<endl;
-		//getchar();getchar();getchar();
-		// save NBV
-		cv::Point nbp = vps[max_index];
+		if (max_index != -1)
+			best_views[fid] = vps[max_index];
+		jitters[fid] = uniform(rng) / 10;
+	});
+	// pose and covered frontiers of every candidate view, concurrently
+	vector<cv::Point> frontier_cells(frt_num);
+	for (int fid = 0; fid < frt_num; fid++)
+		frontier_cells[fid] = cv::Point((int)round(frontier_list[fid].position.x()), -(int)round(frontier_list[fid].position.y()));
+	FrontierCoverage coverage;
+	coverage.build(m_p_de, frontier_cells);
+	vector<iro::SE2> poses(frt_num);
+	vector<FrontierBits> covers(frt_num);
+	m_pool.parallel_for(frt_num, [&](int fid, int worker) {
+		if (best_views[fid].x == -1)
+			return;
+		cv::Point fp(frontier_list[fid].position.x(), -frontier_list[fid].position.y());
+		cv::Point nbp = best_views[fid];
 		Eigen::Vector2d base(0.0, 1.0); // se2 coor
 		Eigen::Vector2d dire(fp.x - nbp.x, -fp.y + nbp.y); // se2 coor
 		dire.normalize();
 		double theta = acos(base.dot(dire) / (dire.norm() * base.norm()));
 		if (dire.x() > 0)
 			theta = -theta;
-		NextBestView nbv(iro::SE2(nbp.x, -nbp.y, theta), 1, nbvs.size());
-		//cerr << "theta = " << theta << endl; // test
-		nbvs.push_back(nbv);
-		//cout << "generated a view stored." << endl;
-		// delete covered frontiers // frustum and visibility check. without openmp. better than with openmp, why?
-		{
-			// erase this frontier
-			frontier_list.erase(frontier_list.begin()); 
-			// erase covered frontiers by this view
-			vector<int> dlt_indexes;
-			vector<cv::Point> nbv_frustum = get_frustum_contuor(nbv.pose);
-			for (int i = 0; i < frontier_list.size(); i++)
-			{
-				// check view frustum
-				if (cv::pointPolygonTest(nbv_frustum, cv::Point((int)round(frontier_list[i].position.x()), -(int)round(frontier_list[i].position.y())), false) > 0) // in field of frustum
-				{
-					// check visiability 
-					cv::Point beg((int)round(nbv.pose.translation().x()), -(int)round(nbv.pose.translation().y()));
-					cv::Point end((int)round(frontier_list[i].position.x()), -(int)round(frontier_list[i].position.y()));
-					// if visiable, delete the covered frontiers from queue
-					if (checkViewRayValidness(beg, end))
-						dlt_indexes.push_back(i);
-				}
-			}
-			if (!dlt_indexes.empty())
-			{
-				for (int i = dlt_indexes.size() - 1; i >= 0; i--)
-				{
-					frontier_list.erase(frontier_list.begin() + dlt_indexes[i]);
-				}
-			}	
+		poses[fid] = iro::SE2(nbp.x, -nbp.y, theta);
+		coverage.cover(get_frustum_contuor(poses[fid]), covers[fid]);
+		FrontierCoverage::set(covers[fid], fid); // its own frontier, seen by construction
+	});
+	// greedy set cover: the view covering most uncovered frontiers first, lowest index on ties.
+	// lazy: gains only shrink, so a stale heap key bounds the true gain from above
+	FrontierBits covered(coverage.words, 0);
+	priority_queue<pair<int, int>> heap; // (gain, -frontier)
+	for (int fid = 0; fid < frt_num; fid++)
+		if (best_views[fid].x != -1)
+			heap.push(make_pair(FrontierCoverage::count_new(covers[fid], covered), -fid));
+	while (!heap.empty())
+	{
+		int fid = -heap.top().second;
+		heap.pop();
+		pair<int, int> crt(FrontierCoverage::count_new(covers[fid], covered), -fid);
+		if (crt.first == 0)
+			continue;
+		if (!heap.empty() && crt < heap.top())
+		{
+			heap.push(crt);
+			continue;
 		}
+		FrontierCoverage::merge(covered, covers[fid]);
+		nbvs.push_back(NextBestView(poses[fid], 1, nbvs.size()));
+	}
+	// frontiers neither covered nor with a view of their own
+	for (int fid = 0; fid < frt_num; fid++)
+	{
+		if (best_views[fid].x == -1 && !FrontierCoverage::test(covered, fid))
+			task_maybe_invalid.insert(Point_2(frontier_list[fid].position.x() + jitters[fid], frontier_list[fid].position.y()), g_plan_iteration);
 	}
 	// end.
 	return nbvs;
@@ -1848,6 +1989,20 @@ vector<int> Navigation::TSP_path(vector<Point_2> points, vector<vector<double>>
 		nodes.push_back(Eigen::Vector2d(points[i].x(), points[i].y()));
 	// TSP solver
 	TSP tsp(nodes, weights);
+	tsp.matching_mode = tsp_matching_mode;
+	tsp.search_time = tsp_search_time;
+	tsp.open_path = true;
+	tsp.path_start = 0;
+	// log every set solved here, exact ones too
+	if (!g_tsp_log_path.empty())
+		tsp.save_instance(g_tsp_log_path);
+	// small sets: exact open path from node 0, no return leg
+	if ((int)points.size() <= tsp_exact_max_nodes)
+	{
+		if (held_karp_path(weights, 0, -1, result) >= 0)
+			return result;
+		result.clear();
+	}
 
 	// Christofides Algorithm
 	{
@@ -1856,11 +2011,6 @@ vector<int> Navigation::TSP_path(vector<Point_2> points, vector<vector<double>>
 		// Find a minimum weighted matching M for odd vertices in T
 		tsp.perfect_matching();
 		// Find the node that leads to the best path - - -
-		// Create array of thread objects
-		MyThread threads[NUM_THREADS];
-		int best = INT_MAX;
-		int bestIndex;
-		int stop_here = NUM_THREADS;
 		// Amount to increment starting node by each time
 		int increment = 1; // by 1 if n < 1040
 		int n = tsp.get_size();
@@ -1878,84 +2028,11 @@ vector<int> Navigation::TSP_path(vector<Point_2> points, vector<vector<double>>
 			increment = 250;		// ~ 220s @ 6447
 		else if (n >= 6500)
 			increment = 500;
-		int remaining = n;
-		// Start at node zero
-		int node = 0;
-		// Count to get thread ids
-		int count = 0;
-		while (remaining >= increment) 
-		{
-			// Keep track iteration when last node will be reached
-			if (remaining < (NUM_THREADS * increment)) 
-			{
-				// each iteration advances NUM_THREADS * increment nodes
-				stop_here = remaining / increment;
-			}
-			for (long t = 0; t < stop_here; t++) 
-			{
-				//cout << "Thread " << count << " starting at node " << node << endl;
-				threads[t].start_node = node;
-				threads[t].my_id = count;
-				threads[t].mytsp = &tsp;
-				threads[t].start();
-				node += increment;
-				count++;
-			}
-			// Wait for all the threads
-			for (long t = 0; t < stop_here; t++) 
-			{
-				threads[t].join();
-			}
-			remaining -= (stop_here * increment);
-		}
-		// Loop through each index used and find shortest path
-		for (long t = 0; t < count; t++) {
-			if (tsp.path_vals[t][1] < best) {
-				bestIndex = tsp.path_vals[t][0];
-				best = tsp.path_vals[t][1];
-			}
-		}
-		// Store best path
-		tsp.create_tour(bestIndex);
-		tsp.make_shorter();
-		tsp.make_shorter();
-		tsp.make_shorter();
-		tsp.make_shorter();
-		tsp.make_shorter();
-	}
-	// path // remove the first/last path, depend on which it longer
-	int start_id = -1;
-	bool posetive_sequence = true;
-	// find start id and sequence direction
-	for (int i = 0; i < tsp.circuit.size(); i++)
-	{
-		if (tsp.circuit[i] == 0)
-		{
-			start_id = i;
-			int ni = (i + 1) % tsp.circuit.size();
-			int li = (i - 1 + tsp.circuit.size()) % tsp.circuit.size();
-			//cerr << "weights[0][tsp.circuit[ni]] = " << weights[0][tsp.circuit[ni]] << endl;
-			//cerr << "weights[0][tsp.circuit[li]] = " << weights[0][tsp.circuit[li]] << endl;
-			if (weights[0][tsp.circuit[ni]] < weights[0][tsp.circuit[li]])
-				posetive_sequence = true;
-			else
-				posetive_sequence = false;
-			break;
-		}
-	}
-	for (int counter = 0; counter < tsp.circuit.size(); counter++)
-	{
-		if (posetive_sequence)
-		{
-			int id = (start_id + counter) % tsp.circuit.size();
-			result.push_back(tsp.circuit[id]);
-		}
-		else
-		{
-			int id = (start_id - counter + tsp.circuit.size()) % tsp.circuit.size();
-			result.push_back(tsp.circuit[id]);
-		}
+		// every start runs euler + hamilton + local search on the pool, the shortest path is kept
+		tsp.multi_start(increment, m_pool);
 	}
+	// open path from the robot (node 0), no return leg
+	result = tsp.circuit;
 	return result;
 }
 
@@ -2054,91 +2131,98 @@ void Navigation::OMT_TSP()
 		m_robot_move_views.resize(rbt_num);
 		for (int rid = 0; rid < rbt_num; rid++)
 			m_robot_move_views[rid].clear();
-		// solve TSP (scan order of tasks) for each robot
+		// slots: robot rid is slot rid, its task tid is slot task_slot[rid] + tid
+		vector<iro::SE2> slot_poses;
+		vector<int> task_slot(rbt_num);
+		for (int rid = 0; rid < rbt_num; rid++)
+			slot_poses.push_back(m_p_de->m_pose2d[rid]);
 		for (int rid = 0; rid < rbt_num; rid++)
 		{
-			// nodes
-			vector<Point_2> nodes; // index == assigned_tasks[rid].index+1
-			nodes.push_back(Point_2(m_robot_sites[rid].x(), m_robot_sites[rid].y()));
+			task_slot[rid] = slot_poses.size();
 			for (int tid = 0; tid < assigned_tasks[rid].size(); tid++)
-				nodes.push_back(Point_2(assigned_tasks[rid][tid].pose.translation().x(), assigned_tasks[rid][tid].pose.translation().y()));
-			// weights
-			vector<vector<double>> weights; // weights
-			weights.resize(nodes.size());
-			for (int i = 0; i < nodes.size(); i++)
-			{
-				weights[i].resize(nodes.size());
-			}
-			// compute weights batch & paralell.
-			{
-				// weights between i j
-				vector<vector<double>> wij(nodes.size());
-				for (int i = 0; i < wij.size(); i++)
-					wij[i].resize(nodes.size());
-#pragma omp parallel for num_threads(8) 
-				//for (int i = 0; i < nodes.size(); i++)
-				for (int i = 0; i < nodes.size() - 1; i++)
+				slot_poses.push_back(iro::SE2(assigned_tasks[rid][tid].pose.translation().x(), assigned_tasks[rid][tid].pose.translation().y(), assigned_tasks[rid][tid].pose.rotation().angle()));
+		}
+		int slot_num = slot_poses.size();
+		// geodesic distances between every distinct node of all slots, computed once
+		vector<Point_2> all_nodes; // robot sites and tasks, distinct
+		vector<int> slot_node(slot_num); // slot -> index in all_nodes
+		{
+			map<pair<double, double>, int> lookup;
+			for (int sid = 0; sid < slot_num; sid++)
+			{
+				// robots plan from their sites, tasks from their views
+				Point_2 p = sid < rbt_num ?
+					Point_2(m_robot_sites[sid].x(), m_robot_sites[sid].y()) :
+					Point_2(slot_poses[sid].translation().x(), slot_poses[sid].translation().y());
+				pair<double, double> key(p.x(), p.y());
+				map<pair<double, double>, int>::iterator it = lookup.find(key);
+				if (it == lookup.end())
 				{
-					vector<Point_2> targets;
-					for (int j = i + 1; j < nodes.size(); j++)
-						targets.push_back(nodes[j]);
-					vector<double> cDistances = m_metric.getGeodesicDistances(nodes[i], targets); // compute geodesic
-					for (int tid = 0; tid < targets.size(); tid++)
-					{
-						int j = tid + i + 1;
-						wij[i][j] = cDistances[tid];
-						wij[j][i] = cDistances[tid];
-					}
+					it = lookup.insert(make_pair(key, (int)all_nodes.size())).first;
+					all_nodes.push_back(p);
+				}
+				slot_node[sid] = it->second;
+			}
+		}
+		vector<vector<double>> geodesics = m_metric.getGeodesicDistanceMatrix(all_nodes, m_pool);
+		// weights between slots = max(geodesic, angle / pi)
+		vector<vector<double>> slot_weights(slot_num, vector<double>(slot_num, 0));
+		{
+			// heading of each slot in [0, 2pi)
+			vector<double> thetas(slot_num);
+			for (int sid = 0; sid < slot_num; sid++)
+			{
+				thetas[sid] = slot_poses[sid].rotation().angle();
+				if (thetas[sid] < 0) thetas[sid] = 2 * PI + thetas[sid];
+			}
+			// rows of geodesics, then a branch free pass over contiguous arrays
+			vector<double> distance_row(slot_num), angle_row(slot_num);
+			bool has_nan = false;
+			for (int i = 0; i < slot_num - 1; i++)
+			{
+				const vector<double> & grow = geodesics[slot_node[i]];
+				for (int j = i + 1; j < slot_num; j++)
+					distance_row[j] = grow[slot_node[j]];
+				double theta1 = thetas[i];
+				const double* t2 = &thetas[0];
+				double* ar = &angle_row[0];
+				double* dr = &distance_row[0];
+				for (int j = i + 1; j < slot_num; j++)
+				{
+					double delta = fabs(theta1 - t2[j]);
+					delta = min(delta, 2 * PI - delta);
+					ar[j] = delta / PI;
 				}
-				// weights
-				//for (int i = 0; i < nodes.size(); i++)
-				for (int i = 0; i < nodes.size() - 1; i++)
+				for (int j = i + 1; j < slot_num; j++)
 				{
-					for (int j = i + 1; j < nodes.size(); j++)
-					{
-						// distance weight
-						double distance_weight = wij[i][j];
-						// angle weight
-						double angle_weight(0);
-						{
-							// theta of node i
-							double theta1;
-							if (i == 0) // i from 0 to size-1, so it may be the first node
-							{
-								theta1 = m_p_de->m_pose2d[rid].rotation().angle();
-							}
-							else
-							{
-								theta1 = assigned_tasks[rid][i - 1].pose.rotation().angle();
-							}
-							if (theta1 < 0) theta1 = 2 * PI + theta1;
-							// theta of node j
-							double theta2 = assigned_tasks[rid][j - 1].pose.rotation().angle();
-							if (theta2 < 0) theta2 = 2 * PI + theta2;
-							double delta = fabs(theta1 - theta2) < 2 * PI - fabs(theta1 - theta2) ? fabs(theta1 - theta2) : 2 * PI - fabs(theta1 - theta2);
-							angle_weight = delta / PI;
-							// check
-							//if (_isnan(angle_weight))
-							if (__isnan(angle_weight))
-							{
-								cerr << "angle_weight = " << angle_weight << " is nan" << endl;
-								cerr << "theta1 = " << theta1 << endl;
-								cerr << "theta2 = " << theta2 << endl;
-								cerr << "delta = " << delta << endl;
-								exit(-1);
-							}
-						}
-						// final weight
-						double final_weight = max(distance_weight, angle_weight);
-						weights[i][j] = weights[j][i] = final_weight;
-					}
+					has_nan = has_nan || __isnan(ar[j]);
+					slot_weights[i][j] = slot_weights[j][i] = max(dr[j], ar[j]);
 				}
-				// release memory
-				for (int i = 0; i < wij.size(); i++)
-					vector<double>().swap(wij[i]);
-				wij.clear();
-				vector<vector<double>>().swap(wij);
 			}
+			// check
+			if (has_nan)
+			{
+				cerr << "error in " << __FUNCTION__ << ", nan tsp weight" << endl;
+				exit(-1);
+			}
+		}
+		// solve TSP (scan order of tasks) for each robot
+		vector<vector<int>> tours(rbt_num); // slots in visit order, robot first
+		for (int rid = 0; rid < rbt_num; rid++)
+		{
+			// nodes
+			vector<int> slots; // index == assigned_tasks[rid].index+1
+			slots.push_back(rid);
+			for (int tid = 0; tid < assigned_tasks[rid].size(); tid++)
+				slots.push_back(task_slot[rid] + tid);
+			int num = slots.size();
+			vector<Point_2> nodes;
+			for (int i = 0; i < num; i++)
+				nodes.push_back(all_nodes[slot_node[slots[i]]]);
+			vector<vector<double>> weights(num, vector<double>(num, 0)); // weights
+			for (int i = 0; i < num; i++)
+				for (int j = 0; j < num; j++)
+					weights[i][j] = slot_weights[slots[i]][slots[j]];
 			// path computation
 			vector<int> point_path;
 			if (nodes.size() == 1)
@@ -2149,33 +2233,28 @@ void Navigation::OMT_TSP()
 			{
 				point_path = TSP_path(nodes, weights); // TSP solver
 			}
-			// store path
 			for (int i = 0; i < point_path.size(); i++)
-			{
-				if (point_path[i] == 0)
-				{
-					// robot current pose
-					m_robot_move_views[rid].push_back(m_p_de->m_pose2d[rid]);
-				}
-				else
-				{
-					// robot next best view poses
-					int tid = point_path[i] - 1;
-					m_robot_move_views[rid].push_back(iro::SE2(assigned_tasks[rid][tid].pose.translation().x(), assigned_tasks[rid][tid].pose.translation().y(), assigned_tasks[rid][tid].pose.rotation().angle()));
-				}
-			}
-			// release memory
-			for (int i = 0; i < weights.size(); i++)
-				vector<double>().swap(weights[i]);
-			weights.clear();
-			vector<vector<double>>().swap(weights);
+				tours[rid].push_back(slots[point_path[i]]);
 			// check
-			if (m_robot_move_views[rid].size() != point_path.size())
+			if (tours[rid].size() != num)
 			{
-				cerr << "size error: " << m_robot_move_views[rid].size() << ", " << point_path.size() << endl;
+				cerr << "size error: " << tours[rid].size() << ", " << num << endl;
 				getchar();
 			}
 		}
+		// lockstep moves end with the slowest robot, shorten the longest tour
+		if (tsp_balance_time > 0)
+		{
+			double before = 0;
+			for (int rid = 0; rid < rbt_num; rid++)
+				before = max(before, tour_length(slot_weights, tours[rid]));
+			double after = balance_tours(slot_weights, tours, tsp_balance_time);
+			cerr << "tour balancing: longest " << before << " -> " << after << endl;
+		}
+		// store path
+		for (int rid = 0; rid < rbt_num; rid++)
+			for (int i = 0; i < tours[rid].size(); i++)
+				m_robot_move_views[rid].push_back(slot_poses[tours[rid][i]]);
 	}
 	// timing
 /*
@@ -2641,12 +2720,18 @@ bool Navigation::compute_sync_move_paths(vector<double> distances)
 		if (distances[rid] != 0 && min_distance > distances[rid])
 			min_distance = distances[rid];
 	}
+	// sample paths
 	for (int rid = 0; rid < rbt_num; rid++)
-	{
 		m_sync_move_paths[rid] = uniformSampleWithNBVInfo(rid, distance_step, min_distance);
-		// path optimization
+	// path optimization
+	{
+		// distance field, shared read only by all segments of this round
+		initDistanceField(m_p_de, m_esdf);
+		PathOptimizer optimizer(m_p_de, m_esdf);
+		// optimize local: cut to segments between nbv nodes and optimize each segment independent
+		vector<int> seg_rid, seg_start, seg_end;
+		for (int rid = 0; rid < rbt_num; rid++)
 		{
-			// optimize local: cut to segments and optimize each segment independent 
 			int start_id = -1, end_id = -1;
 			for (int nid = 0; nid < m_sync_move_paths[rid].size(); nid++)
 			{
@@ -2661,26 +2746,37 @@ bool Navigation::compute_sync_move_paths(vector<double> distances)
 						end_id = nid;
 						if (end_id - start_id > 1) // apply optimization
 						{
-							// path segment set up 
-							vector<iro::SE2> segment;
-							for (int tid = start_id; tid <= end_id; tid++)
-								segment.push_back(m_sync_move_paths[rid][tid]);
-							// optimize by energy function 
-							bool rtn = Optimize_Path(m_p_de, segment);
-cerr << "Optimize_Path success " << rtn << endl;
-							// save 
-							for (int sid = 0, tid = start_id + 1; tid < end_id; sid++, tid++)
-							{
-								m_sync_move_paths[rid][tid].translation().x() = segment[sid].translation().x();
-								m_sync_move_paths[rid][tid].translation().y() = segment[sid].translation().y();
-							}
+							seg_rid.push_back(rid);
+							seg_start.push_back(start_id);
+							seg_end.push_back(end_id);
 						}
 						start_id = end_id;
 						end_id = -1;
 					}
 				}
-			}// optimization end
+			}
+		}
+		// segments of all robots on the pool, each writes its own slot
+		vector<vector<iro::SE2>> segments(seg_rid.size());
+		vector<char> success(seg_rid.size(), 0);
+		m_pool.parallel_for(seg_rid.size(), [&](int sid, int worker) {
+			for (int tid = seg_start[sid]; tid <= seg_end[sid]; tid++)
+				segments[sid].push_back(m_sync_move_paths[seg_rid[sid]][tid]);
+			success[sid] = optimizer.optimize(segments[sid]); // optimize by energy function
+		});
+		// save, in segment order
+		for (int k = 0; k < seg_rid.size(); k++)
+		{
+			cerr << "Optimize_Path success " << (bool)success[k] << endl;
+			for (int sid = 0, tid = seg_start[k] + 1; tid < seg_end[k]; sid++, tid++)
+			{
+				m_sync_move_paths[seg_rid[k]][tid].translation().x() = segments[k][sid].translation().x();
+				m_sync_move_paths[seg_rid[k]][tid].translation().y() = segments[k][sid].translation().y();
+			}
 		}
+	}// optimization end
+	for (int rid = 0; rid < rbt_num; rid++)
+	{
 		// delta_angle
 		double delta_angle = g_angleDifference;
 		// angle optimization quick // to achieve cover uncertainty along path
@@ -2989,49 +3085,51 @@ void Navigation::Trajectory_Optimization()
 		}
 	}
 	// vis.
+	if (m_vis.enabled(VIS_SUMMARY))
 	{
-		cv::Mat statement = m_p_de->visCellMap();
-		// draw sync path
+		// copies for the sink thread
+		cv::Mat base = m_p_de->visCellMapCached();
+		vector<vector<cv::Point>> paths(rbt_num);
 		for (int rid = 0; rid < rbt_num; ++rid)
-		{
 			for (int vid = 0; vid < m_sync_move_paths[rid].size(); ++vid)
+				paths[rid].push_back(cv::Point((int)m_sync_move_paths[rid][vid].translation().x(), -(int)m_sync_move_paths[rid][vid].translation().y()));
+		// draw sync path
+		auto draw_paths = [base, paths]()
+		{
+			cv::Mat statement = base.clone();
+			for (int rid = 0; rid < paths.size(); ++rid)
 			{
-				if (vid>0)
+				for (int vid = 0; vid < paths[rid].size(); ++vid)
 				{
-					cv::line(statement, 
-						cv::Point((int)m_sync_move_paths[rid][vid].translation().x(), -(int)m_sync_move_paths[rid][vid].translation().y()),
-						cv::Point((int)m_sync_move_paths[rid][vid-1].translation().x(), -(int)m_sync_move_paths[rid][vid-1].translation().y()),
-						CV_RGB(255, 0, 255));
+					if (vid>0)
+						cv::line(statement, paths[rid][vid], paths[rid][vid - 1], CV_RGB(255, 0, 255));
+					cv::circle(statement, paths[rid][vid], 2, CV_RGB(0, 0, 255));
 				}
-				cv::circle(statement, cv::Point((int)m_sync_move_paths[rid][vid].translation().x(), -(int)m_sync_move_paths[rid][vid].translation().y()), 2, CV_RGB(0, 0, 255));
 			}
-		}
-		
+			return statement;
+		};
 		// test show frontiers
+		if (m_vis.enabled(VIS_FULL))
 		{
-			// draw frontiers in list
-			cv::Mat temp = statement.clone();
+			vector<cv::Point> listed;
 			for (int fid = 0; fid < m_frontierList.size(); fid++)
-			{
-				int x = m_frontierList[fid].position.x();
-				int y = -m_frontierList[fid].position.y();
-				//cv::circle(temp, cv::Point(x, y), 0, CV_RGB(255, 255, 255));
-				//cv::circle(temp, cv::Point(x, y), 1, CV_RGB(255, 255, 255));
-				cv::circle(temp, cv::Point(x, y), 2, CV_RGB(255, 255, 255));
-			}
+				listed.push_back(cv::Point((int)m_frontierList[fid].position.x(), -(int)m_frontierList[fid].position.y()));
 			// save file
 			char output_path[200];
 			sprintf(output_path, "result/frontierList_%d.png", g_plan_iteration);
-			cv::imwrite(output_path, temp);
+			m_vis.post(VIS_FULL, output_path, [draw_paths, listed]()
+			{
+				// draw frontiers in list
+				cv::Mat temp = draw_paths();
+				for (int fid = 0; fid < listed.size(); fid++)
+					cv::circle(temp, listed[fid], 2, CV_RGB(255, 255, 255));
+				return temp;
+			});
 		}
-
-		// save file
+		// save file and show
 		char output_path[200];
 		sprintf(output_path, "result/plan_%d.png", g_plan_iteration);
-		cv::imwrite(output_path, statement);
-		// show 
-		cv::imshow("plan sync move paths", statement);
-		cv::waitKey(1);
+		m_vis.post(VIS_SUMMARY, output_path, draw_paths, "plan sync move paths");
 	}
 //*/
 	return;
@@ -3069,6 +3167,9 @@ void Navigation::moveRobotsAndScan()
 		{
 			min_size = 1;
 		}
+		// views of every waypoint, scanned by the pipeline below
+		vector<vector<vector<double>>> waypoint_pose7s;
+		vector<vector<iro::SE2>> waypoint_views;
 		// move and scan // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 		// some robots have been assigned no task
 		if (exist_robot_no_task)
@@ -3125,9 +3226,7 @@ void Navigation::moveRobotsAndScan()
 					}
 				}
 				// drive robots to move and scan
-				cerr<<"socket move to views..."<<endl;
-				m_p_de->socket_move_to_views(pose7s);
-				cerr<<"done."<<endl;
+				waypoint_pose7s.push_back(pose7s);
 				// save trajectories
 				for (int rid = 0; rid < rbt_num; rid++)
 				{
@@ -3147,18 +3246,6 @@ void Navigation::moveRobotsAndScan()
 						g_camTrajectories[rid].push_back(m_sync_move_paths[rid][vid]); // for camera trajecoty. 2018-12-30.
 					}
 				}
-				// scan and get data 
-				m_p_de->getPoseFromServer();
-				m_p_de->getRGBDFromServer();
-				// scan data fusion 
-				// insert scans to tree
-				//cerr << "fuseScans2MapAndTree() begin" << endl;
-				m_p_de->fuseScans2MapAndTree();
-				//cerr << "fuseScans2MapAndTree() done." << endl;
-				// project octotree to a 2d map
-				//cerr << "projectOctree2Map() begin" << endl;
-				m_p_de->projectOctree2Map();
-				//cerr << "projectOctree2Map() done." << endl;
 				// vis 
 				vector<iro::SE2> current_views;
 				for (int rid = 0; rid < rbt_num; rid++)
@@ -3168,9 +3255,7 @@ void Navigation::moveRobotsAndScan()
 					else
 						current_views.push_back(m_sync_move_paths[rid][vid]);
 				}
-
-// todo:
-				visualizeScan(current_views, vid);
+				waypoint_views.push_back(current_views);
 /*
 // todo:				
 				move_counter++;
@@ -3225,27 +3310,13 @@ void Navigation::moveRobotsAndScan()
 					}
 				}
 				// drive robots to move and scan
-				cerr<<"socket move to views..."<<endl;
-				m_p_de->socket_move_to_views(pose7s);
-				cerr<<"done."<<endl;
+				waypoint_pose7s.push_back(pose7s);
 				// save trajectories 
 				for (int rid = 0; rid < rbt_num; rid++)
 				{
 					g_rbtTrajectories[rid].push_back(Point_2(m_sync_move_paths[rid][vid].translation().x(), m_sync_move_paths[rid][vid].translation().y()));
 					g_camTrajectories[rid].push_back(m_sync_move_paths[rid][vid]); // for camera trajecoty. 2018-12-30.
 				}
-				// scan and get data 
-				m_p_de->getPoseFromServer();
-				m_p_de->getRGBDFromServer();
-				// scan data fusion 
-				// insert scans to tree
-				//cerr << "fuseScans2MapAndTree() begin" << endl;
-				m_p_de->fuseScans2MapAndTree();
-				//cerr << "fuseScans2MapAndTree() done." << endl;
-				// project octotree to a 2d map
-				//cerr << "projectOctree2Map() begin" << endl;
-				m_p_de->projectOctree2Map();
-				//cerr << "projectOctree2Map() done." << endl;
 				// vis
 				vector<iro::SE2> current_views; // use to vis
 				for (int rid = 0; rid < rbt_num; rid++)
@@ -3255,15 +3326,27 @@ void Navigation::moveRobotsAndScan()
 					else
 						current_views.push_back(m_sync_move_paths[rid][vid]);
 				}
-
-// todo:				
-				visualizeScan(current_views, vid);
+				waypoint_views.push_back(current_views);
 /*
 // todo:
 				move_counter++;
 //*/
 			}
 		}
+		// move, receive and decode waypoint k+1 while waypoint k is fused, projected and drawn.
+		m_p_de->scanPipeline(waypoint_pose7s.size(),
+			[&](int k)
+			{
+				cerr<<"socket move to views..."<<endl;
+				m_p_de->socket_move_to_views(waypoint_pose7s[k]);
+				cerr<<"done."<<endl;
+				// scan and get data 
+				return m_p_de->getPoseFromServer() && m_p_de->getRGBDFromServer();
+			},
+			[&](int k)
+			{
+				visualizeScan(waypoint_views[k], k);
+			});
 	}
 //*/
 	return;
@@ -3312,18 +3395,21 @@ bool draw_robot_views(cv::Mat & input, vector<iro::SE2> views)
 // visualization, not finish
 bool Navigation::visualizeScan(vector<iro::SE2> current_views, int vid) // todo: remove vid.
 {
+	if (!m_vis.enabled(VIS_FULL))
+		return true;
 	// recon
-	cv::Mat statement = m_p_de->visCellMap();
-	// robot position
-	for (int i = 0; i < current_views.size(); ++i)
-	{
-		cv::circle(statement, cv::Point((int)round(current_views[i].translation().x()), (int)round(-current_views[i].translation().y())), 3, CV_RGB(0, 0, 255));
-	}
-	draw_robot_views(statement, current_views);
-	//cv::imshow("robot positions", statement);
-	//cv::waitKey(1);
+	cv::Mat base = m_p_de->visCellMapCached();
 	char output_path[200];
 	sprintf(output_path, "result/_progressive_%d_%d.png", g_plan_iteration, vid);
-	cv::imwrite(output_path, statement);
-	return true;
+	return m_vis.post(VIS_FULL, output_path, [base, current_views]()
+	{
+		cv::Mat statement = base.clone();
+		// robot position
+		for (int i = 0; i < current_views.size(); ++i)
+		{
+			cv::circle(statement, cv::Point((int)round(current_views[i].translation().x()), (int)round(-current_views[i].translation().y())), 3, CV_RGB(0, 0, 255));
+		}
+		draw_robot_views(statement, current_views);
+		return statement;
+	});
 }
\ No newline at end of file
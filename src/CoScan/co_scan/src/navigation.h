@@ -6,6 +6,10 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <queue>
 
 /*
 // cgal
@@ -47,15 +51,39 @@ typedef std::list<Polygon_with_holes_2>                                Pwh_list_
 #include "tsp/tsp.h"			// tsp
 #include "tsp/usage.h"			// tsp
 #include "tsp/twoOpt.h"			// tsp
-#include "tsp/MyThread.h"		// tsp
+#include "tsp/held_karp.h"		// tsp
+#include "tsp/balance.h"		// tsp
 #include "path_optimization.h"	// solve path
+#include "frontier_coverage.h"	// covered frontiers
+#include "polygon_simplify.h"	// move domain simplification
+#include "vis_sink.h"			// debug images
 #define CPS CLOCKS_PER_SEC
-#define NUM_THREADS 1
 
 const int frontier_exploration_sample_range_pixel = 10; //10 pixel = 0.5m
+// frontier cells need this many 8-connected scanned cells around, smaller specks are ignored
+const int frontier_min_region = 5;
 const int offset_size = (int)(0.15/map_cellsize); // offset to avoid collision
 // random site num of CDT
 const int random_site_num = 200; // CDT resolution. 50~200 is OK.
+// move domain simplification tolerance, cells. 0 = off
+const double polygon_simplify_tolerance = 1.5;
+// free space a simplified edge may cut off, cells. its reach into the obstacle margin is capped by offset_size
+const double polygon_simplify_clearance = 1.0;
+// plan rounds a target without reachable views is skipped, 0 = forever. the map grows meanwhile,
+// so it is tried again, and the store stays bounded by the targets of the last rounds
+const int invalid_task_max_age = 10;
+// threads of the planning pool: frontier views, geodesic weight matrix, tsp multi-start, path optimization. 0 = one per core
+const int plan_thread_num = 0;
+// seed of view sampling, plus the plan iteration. 0 = seed from time
+const unsigned int view_random_seed = 0;
+// matching of odd mst nodes, MATCH_BLOSSOM or MATCH_GREEDY
+const int tsp_matching_mode = MATCH_BLOSSOM;
+// task sets up to this size are solved exactly by held-karp, at most held_karp_max_nodes
+const int tsp_exact_max_nodes = held_karp_max_nodes;
+// local search budget of each tsp start, seconds, 0 = until local optimum
+const double tsp_search_time = 0.05;
+// seconds of min-max balancing of the robot tours after tsp, 0 = off
+const double tsp_balance_time = 0.1;
 
 // next best view
 struct NextBestView
@@ -149,27 +177,238 @@ struct FrontierElement
 	}
 };
 
+// targets no view could reach, hashed in unit cells: a lookup reads the 3x3 cells around a point.
+// entries remember their plan round and can expire.
+struct UnreachableStore
+{
+	struct Entry
+	{
+		Point_2 p;
+		int round;
+	};
+	std::unordered_map<long long, std::vector<Entry>> cells;
+	int count = 0;
+
+	static long long key(long long cx, long long cy) { return (long long)(((unsigned long long)cx << 32) ^ (unsigned long long)(cy & 0xffffffffLL)); }
+
+	// like a set: a point already stored is not added again, its round is refreshed
+	void insert(const Point_2 & p, int round)
+	{
+		std::vector<Entry> & v = cells[key((long long)floor(p.x()), (long long)floor(p.y()))];
+		for (int i = 0; i < v.size(); i++)
+		{
+			if (v[i].p == p)
+			{
+				v[i].round = max(v[i].round, round);
+				return;
+			}
+		}
+		v.push_back(Entry{ p, round });
+		count++;
+	}
+
+	// any entry with |dx| < 1 and |dy| < 1
+	bool contains(const Point_2 & p) const
+	{
+		long long cx = (long long)floor(p.x()), cy = (long long)floor(p.y());
+		for (long long x = cx - 1; x <= cx + 1; x++)
+		{
+			for (long long y = cy - 1; y <= cy + 1; y++)
+			{
+				auto it = cells.find(key(x, y));
+				if (it == cells.end())
+					continue;
+				for (int i = 0; i < it->second.size(); i++)
+					if (fabs(p.x() - it->second[i].p.x()) < 1 && fabs(p.y() - it->second[i].p.y()) < 1)
+						return true;
+			}
+		}
+		return false;
+	}
+
+	// drop entries older than max_age rounds, 0 = keep all
+	void expire(int round, int max_age)
+	{
+		if (max_age <= 0)
+			return;
+		for (auto it = cells.begin(); it != cells.end();)
+		{
+			std::vector<Entry> & v = it->second;
+			int kept = 0;
+			for (int i = 0; i < v.size(); i++)
+				if (round - v[i].round <= max_age)
+					v[kept++] = v[i];
+			count -= v.size() - kept;
+			v.erase(v.begin() + kept, v.end());
+			if (v.empty())
+				it = cells.erase(it);
+			else
+				it++;
+		}
+	}
+
+	int size() const { return count; }
+
+	template <class F>
+	void for_each(F f) const
+	{
+		for (auto it = cells.begin(); it != cells.end(); it++)
+			for (int i = 0; i < it->second.size(); i++)
+				f(it->second[i].p);
+	}
+};
+
+// polygons rasterized on the map: cells farther than band from every edge are classified by lookup,
+// the others are NEAR_EDGE and need the exact pointPolygonTest.
+struct PolygonMask
+{
+	enum { OUTSIDE = 0, INSIDE = 1, NEAR_EDGE = 2 };
+	cv::Mat mask;
+
+	void build(const std::vector<std::vector<cv::Point>> & polygons, int band)
+	{
+		mask = cv::Mat::zeros(map_rows, map_cols, CV_8UC1);
+		// one by one, overlapping polygons are a union
+		for (int i = 0; i < polygons.size(); i++)
+		{
+			if (polygons[i].size() < 3)
+				continue;
+			const cv::Point* pts = &polygons[i][0];
+			int npts = polygons[i].size();
+			cv::fillPoly(mask, &pts, &npts, 1, cv::Scalar(INSIDE));
+		}
+		for (int i = 0; i < polygons.size(); i++)
+		{
+			if (polygons[i].empty())
+				continue;
+			const cv::Point* pts = &polygons[i][0];
+			int npts = polygons[i].size();
+			cv::polylines(mask, &pts, &npts, 1, true, cv::Scalar(NEAR_EDGE), 2 * band + 1);
+		}
+	}
+
+	int at(cv::Point p) const
+	{
+		if (mask.empty() || p.x < 0 || p.y < 0 || p.x >= mask.cols || p.y >= mask.rows)
+			return NEAR_EDGE;
+		return mask.ptr<uchar>(p.y)[p.x];
+	}
+};
+
+// scanned free cells of the map bucketed in square tiles, built once per round.
+// view candidates are drawn from it directly instead of scanning windows.
+struct FreeCellIndex
+{
+	int tile = 8; // cells per tile side
+	int tile_rows = 0;
+	int tile_cols = 0;
+	std::vector<int> tile_begin; // cells of tile t: cells[tile_begin[t], tile_begin[t + 1])
+	std::vector<cv::Point> cells; // (x = col, y = row)
+
+	void build(DataEngine* p_de)
+	{
+		tile_rows = (map_rows + tile - 1) / tile;
+		tile_cols = (map_cols + tile - 1) / tile;
+		tile_begin.assign(tile_rows * tile_cols + 1, 0);
+		cells.clear();
+		for (int tr = 0; tr < tile_rows; tr++)
+		{
+			for (int tc = 0; tc < tile_cols; tc++)
+			{
+				tile_begin[tr * tile_cols + tc] = cells.size();
+				for (int r = tr * tile; r < min((tr + 1) * tile, map_rows); r++)
+					for (int c = tc * tile; c < min((tc + 1) * tile, map_cols); c++)
+						if (p_de->m_recon2D.m_cellmap[r][c].isScanned && p_de->m_recon2D.m_cellmap[r][c].isFree)
+							cells.push_back(cv::Point(c, r));
+			}
+		}
+		tile_begin[tile_rows * tile_cols] = cells.size();
+	}
+
+	// up to k cells with rmin < distance <= rmax from center that pass valid(cell), drawn uniformly
+	// without replacement. at most max_checks calls of valid and 4 * max_checks draws, so the work does not grow with the annulus.
+	template <class Valid>
+	void sample(cv::Point center, int rmin, int rmax, int k, int max_checks, std::mt19937 & rng, Valid valid, std::vector<cv::Point> & out) const
+	{
+		out.clear();
+		// tiles overlapping the bounding square, prefix counts of their cells
+		int tr0 = max(center.y - rmax, 0) / tile, tr1 = min(center.y + rmax, map_rows - 1) / tile;
+		int tc0 = max(center.x - rmax, 0) / tile, tc1 = min(center.x + rmax, map_cols - 1) / tile;
+		if (tr0 > tr1 || tc0 > tc1)
+			return;
+		std::vector<int> firsts, prefix(1, 0);
+		for (int tr = tr0; tr <= tr1; tr++)
+		{
+			for (int tc = tc0; tc <= tc1; tc++)
+			{
+				int t = tr * tile_cols + tc;
+				firsts.push_back(tile_begin[t]);
+				prefix.push_back(prefix.back() + tile_begin[t + 1] - tile_begin[t]);
+			}
+		}
+		int total = prefix.back();
+		// partial fisher-yates over [0, total), swapped slots kept sparse
+		std::unordered_map<int, int> swapped;
+		auto slot = [&swapped](int i) {
+			auto it = swapped.find(i);
+			return it == swapped.end() ? i : it->second;
+		};
+		// draws outside the annulus count too, at most max_draws in all
+		const int max_draws = 4 * max_checks;
+		int checks = 0;
+		for (int d = 0; d < total && d < max_draws && out.size() < k && checks < max_checks; d++)
+		{
+			int j = std::uniform_int_distribution<int>(d, total - 1)(rng);
+			int v = slot(j);
+			int u = slot(d);
+			swapped[j] = u;
+			// cell v
+			int b = std::upper_bound(prefix.begin(), prefix.end(), v) - prefix.begin() - 1;
+			cv::Point p = cells[firsts[b] + v - prefix[b]];
+			int dx = p.x - center.x, dy = p.y - center.y;
+			int d2 = dx * dx + dy * dy;
+			if (d2 <= rmin * rmin || d2 > rmax * rmax)
+				continue;
+			checks++;
+			if (valid(p))
+				out.push_back(p);
+		}
+	}
+};
+
 class Navigation
 {
 public:
 
 	int m_max_task_num = 30;
 
-	std::vector<cv::Point> m_boundary;
+	std::vector<cv::Point2f> m_boundary; // cell centers, cell edges when traced by extractDomain
 	std::vector<cv::Point> m_frontiers;
+	cv::Mat m_frontier_mask; // frontier cells 255, kept between rounds
+	std::set<int> m_frontier_cells; // r * map_cols + c of the same cells, raster order
 	std::vector<Point_2> m_frontiers_p2;
-	std::vector<std::vector<cv::Point>> m_holes;
+	std::vector<std::vector<cv::Point2f>> m_holes;
+	bool m_domain_disjoint = false; // holes of extractDomain, apart and strictly inside the boundary
 	int rbt_num;
 	std::vector<Point_2> m_robot_sites; 
 
 	// data engine
 	DataEngine* m_p_de;
+	// debug images, rendered and written off the planning thread
+	VisSink m_vis;
+	// workers of the parallel planning stages, reused every round
+	StealingPool m_pool;
 	// distance metric
 	DistanceMetric m_metric;
+	// distance field of path optimization
+	SignedDistanceField m_esdf;
+	// clearance score of free cells, see computeLoationMap
+	cv::Mat m_location_map;
+	int m_location_map_version = -1;
 
 	// todo: organize temp variables...
 	std::vector<FrontierElement> m_frontierList;
-	std::set<Point_2> task_maybe_invalid;
+	UnreachableStore task_maybe_invalid;
 	std::vector<NextBestView> m_valid_object_nbvs; // valid nbvs for all objects in objectList
 	std::vector<int> m_task_index_in_valid_object_nbvs; // task indexes
 
@@ -179,7 +418,7 @@ public:
 	std::vector<std::vector<iro::SE2>> m_sync_move_paths; // 同步控制机器人移动的每个节点
 
 	// constructor
-	Navigation(DataEngine& de, int paramK=6)
+	Navigation(DataEngine& de, int paramK=6) : m_pool(plan_thread_num)
 	{
 		m_p_de = &de;
 		rbt_num = m_p_de->rbt_num;
@@ -190,9 +429,19 @@ public:
 	// extract boundary, holes, and frontiers
 	void processCurrentScene();
 
+	// boundary and holes from the free cells of one labelling, simple loops along cell edges
+	bool extractDomain(const cv::Mat & obstacle_mat);
+
+	// recompute frontier cells inside the regions the data engine changed since the last round
+	void updateFrontierCells();
+
 	// polygon simplification. reduce number of vertexes.
 	bool simplifyPolygon(Polygon_2 & poly, const double colinearThresh, bool addNoise);
 
+	// joint simplification of boundary and holes, topology preserving. edges reach at most offset_size into
+	// the obstacle margin and cut at most polygon_simplify_clearance off free space
+	void simplifyDomain(Polygon_2 & boundary, vector<Polygon_2> & holes);
+
 	// polygon difference. exact difference of two polygons. use CGAL exact kernel. sometimes CGAL doesn't work...
 	Pwh_list_2 differenceCGALExactKernel(Polygon_with_holes_2 domain, Polygon_2 hole);
 
@@ -3,9 +3,11 @@
 #include <stdio.h> 
 #include <stdlib.h> 
 #include <string.h>
+#include <cmath>
 #include <vector>
 #include <list>
 #include <set>
+#include <stdexcept>
 #include <unistd.h> 				// sleep
 // other headers
 #include "global.h"					// global variables
@@ -15,170 +17,134 @@
 using namespace std;
 using namespace LBFGSpp;
 
-cv::Mat dist;
-vector<int> fixed_node_indexes;
-vector<int> fixed_variabe_indexes;
-double distanceField[map_rows][map_cols];
-
-// distance field
-void initDistanceField(DataEngine* p_de);
-
-// get field value
-double fieldIntensity(Eigen::Vector2d xy);
-
-// get distance from obstacles
-double getValueDistanceField(int r, int c);
-
-// get field gradient
-Eigen::Vector2d fieldGradient(Eigen::Vector2d xy);
-
-// rho
-double rho(Eigen::Vector2d xy);
-
-// grho
-Eigen::Vector2d grho(Eigen::Vector2d xy);
-
-// objective func
-double energyFunc(const Eigen::VectorXd& x, Eigen::VectorXd& grad);
-
-// check if path cross obstacles.
-bool crossObstacles(DataEngine* p_de, int cr, int cc, int lr, int lc);
-
-// get distance from obstacles
-float getValueDist(int r, int c);
-
-// optimization
-bool Optimize_Path(DataEngine* p_de, vector<iro::SE2> & path);
-
-// distance field
-void initDistanceField(DataEngine* p_de)
+// euclidean signed distance field of the cell map, in cells normalized by the
+// largest free distance. positive in scanned free space, negative elsewhere.
+struct SignedDistanceField
 {
-	// distance transform
-	cv::Mat map_mat = p_de->visCellMap();
-	cv::Mat binary_mat(map_rows, map_cols, CV_8UC1);
-	for (int i = 0; i < binary_mat.rows; i++)
+	int rows = 0;
+	int cols = 0;
+	vector<float> data; // row major
+
+	// bilinear value at (x = col, y = row), gradient in grad. clamped to the border, flat outside.
+	double sample(double x, double y, Eigen::Vector2d & grad) const
 	{
-		for (int j = 0; j < binary_mat.cols; j++)
+		grad.setZero();
+		if (data.empty() || !std::isfinite(x) || !std::isfinite(y))
+			return 0;
+		bool outside = x < 0 || y < 0 || x > cols - 1 || y > rows - 1;
+		x = min(max(x, 0.0), (double)(cols - 1));
+		y = min(max(y, 0.0), (double)(rows - 1));
+		int c0 = min((int)x, cols - 2);
+		int r0 = min((int)y, rows - 2);
+		double fx = x - c0, fy = y - r0;
+		const float* row0 = &data[(size_t)r0 * cols + c0];
+		const float* row1 = row0 + cols;
+		double v00 = row0[0], v10 = row0[1], v01 = row1[0], v11 = row1[1];
+		if (!outside)
 		{
-			binary_mat.ptr<uchar>(i)[j] = 0;
-			if (map_mat.ptr<cv::Vec3b>(i)[j][1] == 255)
-				binary_mat.ptr<uchar>(i)[j] = 255;
+			grad.x() = (1 - fy) * (v10 - v00) + fy * (v11 - v01);
+			grad.y() = (1 - fx) * (v01 - v00) + fx * (v11 - v10);
 		}
+		return (1 - fy) * ((1 - fx) * v00 + fx * v10) + fy * ((1 - fx) * v01 + fx * v11);
 	}
-	cv::threshold(binary_mat, binary_mat, 0, 255, cv::THRESH_BINARY);
-	cv::distanceTransform(binary_mat, dist, cv::DIST_L2, 3);
-	cv::normalize(dist, dist, 0, 1., cv::NORM_MINMAX); // normalize distance field.
-	// dist.type() = CV_32F
-	//cv::imshow("normalized distance field", dist);
-	//cv::waitKey(0);
-	return;
-}
+};
+
+// below this distance rho saturates at 255 + 1/min_field_distance, like the clamped distance of the old field
+const double min_field_distance = 0.0001;
 
-// get distance from obstacles
-double getValueDistanceField(int r, int c)
+// path smoothing on a read-only field. reentrant, the state of a call lives in the call,
+// so segments of all robots may be optimized concurrently on one field.
+class PathOptimizer
 {
-	// information field value
+public:
+	PathOptimizer(DataEngine* p_de, const SignedDistanceField & field) : m_p_de(p_de), m_field(field) {}
 
-	//distanceField[r][c] = -(double)getValueDist(r, c);
+	// rho = 255 + 1/d at xy, gradient in grad
+	double rho(const Eigen::Vector2d & xy, Eigen::Vector2d & grad) const;
 
-	distanceField[r][c] = 1.0/(double)getValueDist(r, c);
+	// objective func, the lbfgs functor
+	double operator()(const Eigen::VectorXd& x, Eigen::VectorXd& grad) const;
 
-	cerr<<"distance value "<<distanceField[r][c]<<endl;
-	return distanceField[r][c];
-}
+	// optimization, false if the result leaves the map or crosses obstacles
+	bool optimize(vector<iro::SE2> & path) const;
 
-// get distance from obstacles
-float getValueDist(int r, int c)
-{
-	float d = dist.ptr<float>(r)[c];
-	if (d<=0) d = 0.0001;
-	return d;
-}
+private:
+	DataEngine* m_p_de; // cell map, read only
+	const SignedDistanceField & m_field;
+};
 
-// get field value
-double fieldIntensity(Eigen::Vector2d xy)
-{
-	cv::Point p((int)round(xy.x()), (int)round(xy.y()));
-	if (p.x<0 || p.x>map_cols || p.y<0 || p.y>map_rows)
-		return 0;
-	//return distanceField[p.y][p.x];
-	return getValueDistanceField(p.y, p.x);
-}
+// esdf of the current map, once per round before path optimization
+void initDistanceField(DataEngine* p_de, SignedDistanceField & esdf);
 
-// get field gradient
-Eigen::Vector2d fieldGradient(Eigen::Vector2d xy)
-{
-	cv::Point p((int)round(xy.x()), (int)round(xy.y()));
-	if (p.x<0 || p.x>map_cols || p.y<0 || p.y>map_rows)
-		return Eigen::Vector2d(0, 0);
-	Eigen::Vector2d grd;
-	grd.x() = getValueDistanceField(p.y, p.x + 1) - getValueDistanceField(p.y, p.x);
-	grd.y() = getValueDistanceField(p.y + 1, p.x) - getValueDistanceField(p.y, p.x);
-	return grd;
-}
+// check if path cross obstacles.
+bool crossObstacles(DataEngine* p_de, int cr, int cc, int lr, int lc);
 
-// rho
-double rho(Eigen::Vector2d xy)
+// esdf of the current map
+void initDistanceField(DataEngine* p_de, SignedDistanceField & esdf)
 {
-	return pow((255 + fieldIntensity(xy)), 1);
+	// free mask: scanned free cells
+	cv::Mat free_mat = p_de->freeMask();
+	cv::Mat other_mat = 255 - free_mat;
+	// distance to the nearest other cell inside free space, to the nearest free cell outside
+	cv::Mat inside, outside; // CV_32F
+	cv::distanceTransform(free_mat, inside, cv::DIST_L2, 3);
+	cv::distanceTransform(other_mat, outside, cv::DIST_L2, 3);
+	double max_inside = 0;
+	cv::minMaxLoc(inside, NULL, &max_inside);
+	float scale = max_inside > 0 ? (float)(1.0 / max_inside) : 1.0f;
+	esdf.rows = map_rows;
+	esdf.cols = map_cols;
+	esdf.data.resize((size_t)map_rows * map_cols);
+	for (int i = 0; i < map_rows; i++)
+	{
+		const float* in = inside.ptr<float>(i);
+		const float* out = outside.ptr<float>(i);
+		float* d = &esdf.data[(size_t)i * map_cols];
+		for (int j = 0; j < map_cols; j++)
+			d[j] = (in[j] - out[j]) * scale;
+	}
+	return;
 }
 
-// grho
-Eigen::Vector2d grho(Eigen::Vector2d xy)
+// rho = 255 + 1/d at xy, gradient in grad
+double PathOptimizer::rho(const Eigen::Vector2d & xy, Eigen::Vector2d & grad) const
 {
-	return fieldGradient(xy);
+	Eigen::Vector2d g_d;
+	double d = m_field.sample(xy.x(), xy.y(), g_d);
+	const double e = min_field_distance;
+	if (d >= e)
+	{
+		grad = -g_d / (d * d);
+		return 255 + 1 / d;
+	}
+	grad.setZero();
+	return 255 + 1 / e;
 }
 
 // objective func
-double energyFunc(const Eigen::VectorXd& x, Eigen::VectorXd& grad)
+double PathOptimizer::operator()(const Eigen::VectorXd& x, Eigen::VectorXd& grad) const
 {
-	// f = sigma rho(mid)^2 * ( x_i - x_i+1 )^2
-	// df = 
+	// f = sigma rho(mid)^3 * |p_k - p_k+1|^2, one field sample per segment
+	// df/dp_k = 2 (p_k - p_k+1) rho^3 + 3/2 |p_k - p_k+1|^2 rho^2 grho, mirrored for p_k+1
 	const int n = x.size();
-	// f
+	grad.setZero();
 	double f(0);
-	for (int i = 0; i < n - 4; i += 2)
-	{
-		Eigen::Vector2d mid((x[i] + x[i + 2]) / 2, (x[i + 1] + x[i + 3]) / 2);
-		f +=
-			(
-			pow((x[i] - x[i + 2]), 2)
-			+
-			pow((x[i + 1] - x[i + 3]), 2)
-			)
-			*
-			//pow(rho(mid), 2);
-			pow(rho(mid), 3); // 2018-09-23
-	}
-	// grad
-	// fix begin and end points
-	{
-		grad[0] = 0;
-		grad[1] = 0;
-		grad[n - 2] = 0;
-		grad[n - 1] = 0;
-	}
-	// gradients of other points
-	for (int i = 2; i < n - 2; i += 2)
+	for (int i = 0; i + 3 < n; i += 2)
 	{
-		Eigen::Vector2d xy_i(x[i], x[i + 1]);
-		// next point
-		Eigen::Vector2d xy_n(x[i + 2], x[i + 3]);
-		Eigen::Vector2d mid_n = (xy_i + xy_n) / 2;
-		Eigen::Vector2d g_mid_n = grho(mid_n);
-		// last point
-		Eigen::Vector2d xy_l(x[i - 2], x[i - 1]);
-		Eigen::Vector2d mid_l = (xy_i + xy_l) / 2;
-		Eigen::Vector2d g_mid_l = grho(mid_l);
-		grad[i] =
-			3 * rho(mid_n) * g_mid_n.x() * (pow(x[i] - x[i + 2], 2) + pow(x[i + 1] - x[i + 3], 2)) + pow(rho(mid_n), 2) * 2 * (x[i] - x[i + 2])
-			+
-			3 * rho(mid_l) * g_mid_l.x() * (pow(x[i] - x[i - 2], 2) + pow(x[i + 1] - x[i - 1], 2)) + pow(rho(mid_l), 2) * 2 * (x[i] - x[i - 2]);
-
-		grad[i + 1] =
-			3 * rho(mid_n) * g_mid_n.y() * (pow(x[i] - x[i + 2], 2) + pow(x[i + 1] - x[i + 3], 2)) + pow(rho(mid_n), 2) * 2 * (x[i + 1] - x[i + 3])
-			+
-			3 * rho(mid_l) * g_mid_l.y() * (pow(x[i] - x[i - 2], 2) + pow(x[i + 1] - x[i - 1], 2)) + pow(rho(mid_l), 2) * 2 * (x[i + 1] - x[i - 1]);
+		Eigen::Vector2d p(x[i], x[i + 1]);
+		Eigen::Vector2d q(x[i + 2], x[i + 3]);
+		Eigen::Vector2d g_rho;
+		double r = rho((p + q) / 2, g_rho);
+		Eigen::Vector2d diff = p - q;
+		double len2 = diff.squaredNorm();
+		double r2 = r * r;
+		f += len2 * r2 * r;
+		Eigen::Vector2d g_len = 2 * r2 * r * diff;
+		Eigen::Vector2d g_mid = 1.5 * len2 * r2 * g_rho;
+		grad[i] += g_len.x() + g_mid.x();
+		grad[i + 1] += g_len.y() + g_mid.y();
+		grad[i + 2] += -g_len.x() + g_mid.x();
+		grad[i + 3] += -g_len.y() + g_mid.y();
 	}
 	// fix begin and end points
 	{
@@ -279,10 +245,10 @@ bool crossObstacles(DataEngine* p_de, int cr, int cc, int lr, int lc)
 }
 
 // optimization
-bool Optimize_Path(DataEngine* p_de, vector<iro::SE2> & path)
+bool PathOptimizer::optimize(vector<iro::SE2> & path) const
 {
+	DataEngine* p_de = m_p_de;
 	// set up
-	initDistanceField(p_de);
 	const int n = path.size() * 2;
 	LBFGSParam<double> param;
 	param.epsilon = 1e-6;
@@ -290,18 +256,10 @@ bool Optimize_Path(DataEngine* p_de, vector<iro::SE2> & path)
 	param.max_iterations = 10;
 	LBFGSSolver<double> solver(param);
 	Eigen::VectorXd x = Eigen::VectorXd::Zero(n); // variable
-	fixed_node_indexes.clear(); // fixed point
-	fixed_variabe_indexes.clear(); // fixed point
 	for (int nid = 0; nid < path.size(); nid++)
 	{
 		x[nid * 2] = path[nid].translation().x();
 		x[nid * 2 + 1] = -path[nid].translation().y();
-		if (fabs(path[nid].rotation().angle() - 0.0) > 0.01) // key view
-		{
-			fixed_node_indexes.push_back(nid);
-			fixed_variabe_indexes.push_back(nid * 2);
-			fixed_variabe_indexes.push_back(nid * 2 + 1);
-		}
 	}
 	double fx;
 /*
@@ -318,7 +276,15 @@ bool Optimize_Path(DataEngine* p_de, vector<iro::SE2> & path)
 	}
 //*/
 
-	int niter = solver.minimize(energyFunc, x, fx); // lbfgs
+	// lbfgs. the line search throws when it fails, keep the path then: this runs on pool workers
+	try
+	{
+		solver.minimize(*this, x, fx);
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
 /*
 	// vis show result
 	{
@@ -343,7 +309,6 @@ bool Optimize_Path(DataEngine* p_de, vector<iro::SE2> & path)
 		int cc = (int)round(x[nid * 2]);
 		// avoid out of boundary. 2018-09-24.
 		if (cr < 0 || cr >= map_rows || cc < 0 || cc >= map_cols) return false;
-		//if (getValueDist((int)round(x[nid * 2 + 1]), (int)round(x[nid * 2]))) return false;
 		// avoid crossing obstacles when sample points are few. 2019-06-12.
 		if (nid > 0) if (crossObstacles(p_de, cr, cc, lr, lc)) return false;
 		lr = cr;
@@ -0,0 +1,277 @@
+#pragma once
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+// other headers
+#include <Eigen/Dense>
+
+using namespace std;
+
+// joint simplification of the rings of a domain, ring 0 the outer boundary and the
+// others holes, any orientation. visvalingam order by deviation: a vertex goes when
+// - every original point between its neighbours stays within tolerance of the new edge,
+// - the new edge reaches at most margin into the obstacle side, where it adds free space,
+// - and cuts at most clearance off free space,
+// - the new edge touches no other edge of any ring and the cut triangle holds no vertex,
+// so no ring self intersects and no hole crosses the boundary that did not before.
+class DomainSimplifier
+{
+public:
+	double tolerance = 1.5;
+	double margin = 3;
+	double clearance = 1;
+
+	// simplify rings in place, vertex count after
+	int simplify(vector<vector<Eigen::Vector2d>> & rings)
+	{
+		setup(rings);
+		typedef pair<double, int> Item; // (deviation, vertex)
+		priority_queue<Item, vector<Item>, greater<Item>> heap;
+		for (int v = 0; v < m_pts.size(); v++)
+			push(heap, v);
+		while (!heap.empty())
+		{
+			Item item = heap.top();
+			heap.pop();
+			int v = item.second;
+			if (!m_alive[v] || item.first != m_cost[v])
+				continue; // removed or stale
+			if (!removable(v))
+				continue;
+			int p = m_prev[v], n = m_next[v];
+			m_alive[v] = 0;
+			m_next[p] = n;
+			m_prev[n] = p;
+			m_ring_size[m_ring[v]]--;
+			addEdge(p);
+			push(heap, p);
+			push(heap, n);
+		}
+		// write back
+		int count = 0;
+		for (int r = 0; r < rings.size(); r++)
+		{
+			rings[r].clear();
+			for (int v = m_first[r]; v < m_first[r + 1]; v++)
+				if (m_alive[v])
+					rings[r].push_back(m_pts[v]);
+			count += rings[r].size();
+		}
+		return count;
+	}
+
+private:
+	vector<Eigen::Vector2d> m_pts;	// all ring vertexes, ring r at [m_first[r], m_first[r + 1])
+	vector<int> m_first;
+	vector<int> m_ring;
+	vector<int> m_prev, m_next;		// alive neighbours
+	vector<char> m_alive;
+	vector<double> m_cost;			// deviation of the current candidate, -1 none
+	vector<int> m_ring_size;
+	vector<char> m_free_left;		// free space on the left of the ring's edges
+	// uniform grid of edges, by start vertex. lazy: an entry is valid while its start is alive and its end unchanged
+	double m_cell = 8;
+	double m_x0 = 0, m_y0 = 0;
+	int m_gw = 0, m_gh = 0;
+	vector<vector<pair<int, int>>> m_grid; // (start, end)
+
+	void setup(const vector<vector<Eigen::Vector2d>> & rings)
+	{
+		m_pts.clear();
+		m_first.assign(1, 0);
+		m_ring.clear();
+		m_ring_size.clear();
+		m_free_left.clear();
+		for (int r = 0; r < rings.size(); r++)
+		{
+			double area = 0;
+			for (int i = 0; i < rings[r].size(); i++)
+			{
+				const Eigen::Vector2d & a = rings[r][i];
+				const Eigen::Vector2d & b = rings[r][(i + 1) % rings[r].size()];
+				area += a.x() * b.y() - b.x() * a.y();
+				m_pts.push_back(a);
+				m_ring.push_back(r);
+			}
+			m_first.push_back(m_pts.size());
+			m_ring_size.push_back(rings[r].size());
+			// boundary: free inside, left of ccw edges. holes: free outside, right of ccw edges
+			m_free_left.push_back((area > 0) == (r == 0));
+		}
+		int n = m_pts.size();
+		m_prev.resize(n);
+		m_next.resize(n);
+		m_alive.assign(n, 1);
+		m_cost.assign(n, -1);
+		for (int r = 0; r < rings.size(); r++)
+		{
+			int b = m_first[r], e = m_first[r + 1];
+			for (int v = b; v < e; v++)
+			{
+				m_prev[v] = v == b ? e - 1 : v - 1;
+				m_next[v] = v + 1 == e ? b : v + 1;
+			}
+		}
+		// grid over the bounding box
+		m_grid.clear();
+		if (n == 0)
+			return;
+		double x1 = m_pts[0].x(), y1 = m_pts[0].y();
+		m_x0 = x1;
+		m_y0 = y1;
+		for (int v = 0; v < n; v++)
+		{
+			m_x0 = min(m_x0, m_pts[v].x());
+			m_y0 = min(m_y0, m_pts[v].y());
+			x1 = max(x1, m_pts[v].x());
+			y1 = max(y1, m_pts[v].y());
+		}
+		m_gw = (int)((x1 - m_x0) / m_cell) + 1;
+		m_gh = (int)((y1 - m_y0) / m_cell) + 1;
+		m_grid.resize((size_t)m_gw * m_gh);
+		for (int v = 0; v < n; v++)
+			addEdge(v);
+	}
+
+	int gx(double x) const { return min(max((int)((x - m_x0) / m_cell), 0), m_gw - 1); }
+	int gy(double y) const { return min(max((int)((y - m_y0) / m_cell), 0), m_gh - 1); }
+
+	void addEdge(int a)
+	{
+		int b = m_next[a];
+		const Eigen::Vector2d & pa = m_pts[a];
+		const Eigen::Vector2d & pb = m_pts[b];
+		for (int y = gy(min(pa.y(), pb.y())); y <= gy(max(pa.y(), pb.y())); y++)
+			for (int x = gx(min(pa.x(), pb.x())); x <= gx(max(pa.x(), pb.x())); x++)
+				m_grid[(size_t)y * m_gw + x].push_back(make_pair(a, b));
+	}
+
+	// candidate of v if its deviation, reach and shrink are in bounds
+	void push(priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> & heap, int v)
+	{
+		m_cost[v] = -1;
+		if (!m_alive[v] || m_ring_size[m_ring[v]] <= 3)
+			return;
+		int p = m_prev[v], n = m_next[v];
+		int r = m_ring[v];
+		int b = m_first[r], e = m_first[r + 1];
+		Eigen::Vector2d d = m_pts[n] - m_pts[p];
+		double len = d.norm();
+		double deviation = 0, reach = 0, shrink = 0;
+		// original points strictly between p and n
+		for (int q = p + 1 == e ? b : p + 1; q != n; q = q + 1 == e ? b : q + 1)
+		{
+			Eigen::Vector2d w = m_pts[q] - m_pts[p];
+			double dist, side;
+			if (len < 1e-9)
+			{
+				dist = w.norm();
+				side = 0;
+			}
+			else
+			{
+				side = (d.x() * w.y() - d.y() * w.x()) / len; // > 0 left
+				double t = d.dot(w) / (len * len);
+				dist = t <= 0 ? w.norm() : t >= 1 ? (m_pts[q] - m_pts[n]).norm() : fabs(side);
+			}
+			deviation = max(deviation, dist);
+			// a point on the free side: the new edge passes behind it, into the obstacle margin.
+			// a point on the obstacle side: the new edge cuts free space off
+			if (side != 0 && (side > 0) == m_free_left[r])
+				reach = max(reach, fabs(side));
+			else if (side != 0)
+				shrink = max(shrink, fabs(side));
+		}
+		if (deviation > tolerance || reach > margin || shrink > clearance)
+			return;
+		m_cost[v] = deviation;
+		heap.push(make_pair(deviation, v));
+	}
+
+	static double cross(const Eigen::Vector2d & a, const Eigen::Vector2d & b, const Eigen::Vector2d & c)
+	{
+		return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	}
+
+	// c on the closed segment ab, given collinear
+	static bool onSegment(const Eigen::Vector2d & a, const Eigen::Vector2d & b, const Eigen::Vector2d & c)
+	{
+		return min(a.x(), b.x()) <= c.x() && c.x() <= max(a.x(), b.x()) &&
+			min(a.y(), b.y()) <= c.y() && c.y() <= max(a.y(), b.y());
+	}
+
+	// closed segments ab and cd intersect, touching counts
+	static bool intersect(const Eigen::Vector2d & a, const Eigen::Vector2d & b, const Eigen::Vector2d & c, const Eigen::Vector2d & d)
+	{
+		double d1 = cross(c, d, a), d2 = cross(c, d, b), d3 = cross(a, b, c), d4 = cross(a, b, d);
+		if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0)))
+			return true;
+		return (d1 == 0 && onSegment(c, d, a)) || (d2 == 0 && onSegment(c, d, b)) ||
+			(d3 == 0 && onSegment(a, b, c)) || (d4 == 0 && onSegment(a, b, d));
+	}
+
+	// closed triangle abc holds q
+	static bool inTriangle(const Eigen::Vector2d & a, const Eigen::Vector2d & b, const Eigen::Vector2d & c, const Eigen::Vector2d & q)
+	{
+		double d0 = cross(a, b, q), d1 = cross(b, c, q), d2 = cross(c, a, q);
+		return !((d0 < 0 || d1 < 0 || d2 < 0) && (d0 > 0 || d1 > 0 || d2 > 0));
+	}
+
+	// edge p-n, replacing p-v-n, keeps all rings simple and apart
+	bool removable(int v)
+	{
+		int p = m_prev[v], n = m_next[v];
+		const Eigen::Vector2d & P = m_pts[p];
+		const Eigen::Vector2d & V = m_pts[v];
+		const Eigen::Vector2d & N = m_pts[n];
+		double xmin = min(P.x(), min(V.x(), N.x())), xmax = max(P.x(), max(V.x(), N.x()));
+		double ymin = min(P.y(), min(V.y(), N.y())), ymax = max(P.y(), max(V.y(), N.y()));
+		for (int y = gy(ymin); y <= gy(ymax); y++)
+		{
+			for (int x = gx(xmin); x <= gx(xmax); x++)
+			{
+				vector<pair<int, int>> & bucket = m_grid[(size_t)y * m_gw + x];
+				for (int k = 0; k < bucket.size(); k++)
+				{
+					int a = bucket[k].first, b = bucket[k].second;
+					if (!m_alive[a] || m_next[a] != b)
+					{
+						// stale, drop
+						bucket[k] = bucket.back();
+						bucket.pop_back();
+						k--;
+						continue;
+					}
+					if (a == v || b == v)
+						continue; // the edges being replaced
+					const Eigen::Vector2d & A = m_pts[a];
+					const Eigen::Vector2d & B = m_pts[b];
+					if (b == p)
+					{
+						// edge into p must not fold back over p-n
+						if (cross(P, N, A) == 0 && onSegment(P, N, A))
+							return false;
+						continue;
+					}
+					if (a == n)
+					{
+						// edge out of n must not fold back over p-n
+						if (cross(P, N, B) == 0 && onSegment(P, N, B))
+							return false;
+						continue;
+					}
+					if (a != p && a != n && inTriangle(P, V, N, A))
+						return false;
+					if (intersect(P, N, A, B))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+};
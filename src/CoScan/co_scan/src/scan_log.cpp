@@ -0,0 +1,136 @@
+#include "scan_log.h"
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+using namespace std;
+
+// monotonic seconds
+double scanLogNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// open <path>.bin and <path>.idx, truncate.
+bool ScanLogWriter::open(const string & path)
+{
+    close();
+    m_bin = fopen((path + ".bin").c_str(), "wb");
+    m_idx = fopen((path + ".idx").c_str(), "wb");
+    if (!m_bin || !m_idx)
+    {
+        cerr << "error in " << __FUNCTION__ << ", can't open scan log " << path << endl;
+        close();
+        return false;
+    }
+    m_offset = 0;
+    m_begin = scanLogNow();
+    cerr << "recording scans to " << path << endl;
+    return true;
+}
+
+// append a payload
+bool ScanLogWriter::write(uint32_t type, uint32_t step, uint32_t rbt_num, const char* data, uint32_t length)
+{
+    if (!isOpen())
+        return false;
+    ScanLogRecord record;
+    record.type = type;
+    record.step = step;
+    record.rbt_num = rbt_num;
+    record.length = length;
+    record.offset = m_offset;
+    record.stamp = scanLogNow() - m_begin;
+    if (fwrite(data, 1, length, m_bin) != length || fwrite(&record, sizeof(record), 1, m_idx) != 1)
+    {
+        cerr << "error in " << __FUNCTION__ << ", scan log write failed, recording stopped" << endl;
+        close();
+        return false;
+    }
+    m_offset += length;
+    // keep the index usable if the planner dies.
+    fflush(m_idx);
+    return true;
+}
+
+// flush and close
+void ScanLogWriter::close()
+{
+    if (m_bin) fclose(m_bin);
+    if (m_idx) fclose(m_idx);
+    m_bin = NULL;
+    m_idx = NULL;
+}
+
+// open <path>.bin and <path>.idx
+bool ScanLogReader::open(const string & path, bool paced)
+{
+    close();
+    FILE* idx = fopen((path + ".idx").c_str(), "rb");
+    m_bin = fopen((path + ".bin").c_str(), "rb");
+    if (!idx || !m_bin)
+    {
+        cerr << "error in " << __FUNCTION__ << ", can't open scan log " << path << endl;
+        if (idx) fclose(idx);
+        close();
+        return false;
+    }
+    ScanLogRecord record;
+    while (fread(&record, sizeof(record), 1, idx) == 1)
+        m_index.push_back(record);
+    fclose(idx);
+    m_cursor = 0;
+    m_paced = paced;
+    m_begin = scanLogNow();
+    cerr << "replaying " << m_index.size() << " scan records from " << path << (paced ? ", recorded pacing" : "") << endl;
+    return true;
+}
+
+// next payload of the given type
+bool ScanLogReader::next(uint32_t type, vector<char> & payload, ScanLogRecord & record)
+{
+    while (m_cursor < (int)m_index.size() && m_index[m_cursor].type != type)
+        m_cursor++;
+    if (m_cursor >= (int)m_index.size())
+        return false;
+    record = m_index[m_cursor++];
+    payload.resize(record.length);
+    if (fseeko(m_bin, (off_t)record.offset, SEEK_SET) != 0 || fread(&payload[0], 1, record.length, m_bin) != record.length)
+    {
+        cerr << "error in " << __FUNCTION__ << ", truncated scan log at step " << record.step << endl;
+        return false;
+    }
+    if (m_paced)
+    {
+        double wait = record.stamp - (scanLogNow() - m_begin);
+        if (wait > 0)
+            usleep((useconds_t)(wait * 1e6));
+    }
+    return true;
+}
+
+// jump to the first record of a step
+bool ScanLogReader::seekStep(uint32_t step)
+{
+    for (int i = 0; i < (int)m_index.size(); i++)
+    {
+        if (m_index[i].step == step)
+        {
+            m_cursor = i;
+            m_begin = scanLogNow() - m_index[i].stamp;
+            return true;
+        }
+    }
+    return false;
+}
+
+// close
+void ScanLogReader::close()
+{
+    if (m_bin) fclose(m_bin);
+    m_bin = NULL;
+    m_index.clear();
+    m_cursor = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// session log of the scan stream.
+// <path>.bin holds payloads in socket wire format, <path>.idx holds one ScanLogRecord per payload.
+
+// record types
+enum ScanLogType
+{
+	SCANLOG_POSE = 1,	// rbt_num * 7 float
+	SCANLOG_RGB = 2,	// rbt_num * 480 * 640 * 3 uchar
+	SCANLOG_DEPTH = 3	// rbt_num * 480 * 640 short
+};
+
+// index entry
+struct ScanLogRecord
+{
+	uint32_t type;		// ScanLogType
+	uint32_t step;		// frame step, increased by every pose
+	uint32_t rbt_num;	// robot number
+	uint32_t length;	// payload bytes
+	uint64_t offset;	// payload offset in .bin
+	double stamp;		// seconds since recording began
+};
+
+// write a session log
+class ScanLogWriter
+{
+	FILE* m_bin = NULL;
+	FILE* m_idx = NULL;
+	uint64_t m_offset = 0;
+	double m_begin = 0;
+public:
+	~ScanLogWriter() { close(); }
+	// open <path>.bin and <path>.idx, truncate.
+	bool open(const std::string & path);
+	// append a payload
+	bool write(uint32_t type, uint32_t step, uint32_t rbt_num, const char* data, uint32_t length);
+	// flush and close
+	void close();
+	bool isOpen() { return m_bin != NULL; }
+};
+
+// read a session log in recorded order
+class ScanLogReader
+{
+	FILE* m_bin = NULL;
+	std::vector<ScanLogRecord> m_index;
+	int m_cursor = 0;
+	bool m_paced = false;	// sleep to recorded pacing, otherwise as fast as possible
+	double m_begin = 0;
+public:
+	~ScanLogReader() { close(); }
+	// open <path>.bin and <path>.idx
+	bool open(const std::string & path, bool paced = false);
+	// next payload of the given type, records of other types in between are skipped.
+	bool next(uint32_t type, std::vector<char> & payload, ScanLogRecord & record);
+	// jump to the first record of a step
+	bool seekStep(uint32_t step);
+	// close
+	void close();
+	bool isOpen() { return m_bin != NULL; }
+	bool finished() { return m_cursor >= (int)m_index.size(); }
+	int size() { return m_index.size(); }
+};
+
+// monotonic seconds
+double scanLogNow();
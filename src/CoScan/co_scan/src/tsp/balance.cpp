@@ -0,0 +1,185 @@
+//==================================================================
+// File			: balance.cpp
+// Description	: Min-max balancing of open tours between robots
+//==================================================================
+
+#include "balance.h"
+#include "local_search.h"
+#include <algorithm>
+#include <chrono>
+
+// improvements below this are rounding noise
+static const double eps = 1e-9;
+
+double tour_length(const vector<vector<double> > &weights, const vector<int> &tour)
+{
+	double length = 0;
+	for (int i = 0; i + 1 < (int)tour.size(); i++)
+		length += weights[tour[i]][tour[i + 1]];
+	return length;
+}
+
+namespace {
+
+enum MoveType { RELOCATE, SWAP, EXCHANGE_TAILS };
+
+struct Move
+{
+	int type;
+	int b;		// other tour
+	int i;		// position in the longest tour
+	int j;		// position in tour b
+	double score;	// longer of the two new lengths
+};
+
+// edges of the node at position i of tour if it were v
+double around(const vector<vector<double> > &w, const vector<int> &tour, int i, int v)
+{
+	double cost = w[tour[i - 1]][v];
+	if (i + 1 < (int)tour.size())
+		cost += w[v][tour[i + 1]];
+	return cost;
+}
+
+// prefix[i]: length from the start to position i, suffix[i]: from i to the end
+void partial_lengths(const vector<vector<double> > &w, const vector<int> &tour, vector<double> &prefix, vector<double> &suffix)
+{
+	int n = tour.size();
+	prefix.assign(n, 0);
+	suffix.assign(n, 0);
+	for (int i = 1; i < n; i++)
+		prefix[i] = prefix[i - 1] + w[tour[i - 1]][tour[i]];
+	for (int i = n - 2; i >= 0; i--)
+		suffix[i] = suffix[i + 1] + w[tour[i]][tour[i + 1]];
+}
+
+// intra tour local search, the start stays first
+void improve(const vector<vector<double> > &w, vector<int> &tour)
+{
+	int n = tour.size();
+	if (n < 4)
+		return;
+	vector<double> flat((size_t)n * n);
+	vector<double*> rows(n);
+	for (int a = 0; a < n; a++) {
+		rows[a] = &flat[(size_t)a * n];
+		for (int b = 0; b < n; b++)
+			rows[a][b] = w[tour[a]][tour[b]];
+	}
+	vector<int> path(n);
+	for (int i = 0; i < n; i++)
+		path[i] = i;
+	vector<vector<int> > neighbors;
+	nearest_neighbors(&rows[0], n, 10, neighbors);
+	double length = 0;
+	local_search_path(&rows[0], path, length, false, neighbors);
+	vector<int> result(n);
+	for (int i = 0; i < n; i++)
+		result[i] = tour[path[i]];
+	tour.swap(result);
+}
+
+}
+
+double balance_tours(const vector<vector<double> > &weights, vector<vector<int> > &tours, double time_budget)
+{
+	const vector<vector<double> > &w = weights;
+	int m = tours.size();
+	vector<double> lengths(m);
+	for (int r = 0; r < m; r++)
+		lengths[r] = tour_length(w, tours[r]);
+	if (m < 2)
+		return m == 1 ? lengths[0] : 0;
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	vector<double> prefix_a, suffix_a, prefix_b, suffix_b;
+	while (true) {
+		if (time_budget > 0 &&
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() > time_budget)
+			break;
+		// longest tour, lowest index on ties
+		int a = max_element(lengths.begin(), lengths.end()) - lengths.begin();
+		const vector<int> &A = tours[a];
+		int na = A.size();
+		partial_lengths(w, A, prefix_a, suffix_a);
+
+		// best move lowers both touched tours below the longest one
+		Move best = { -1, -1, -1, -1, lengths[a] - eps };
+		for (int b = 0; b < m; b++) {
+			if (b == a)
+				continue;
+			const vector<int> &B = tours[b];
+			int nb = B.size();
+			// relocate A[i] after B[j]
+			for (int i = 1; i < na; i++) {
+				double removed = around(w, A, i, A[i]) - (i + 1 < na ? w[A[i - 1]][A[i + 1]] : 0);
+				double new_a = lengths[a] - removed;
+				if (new_a >= best.score)
+					continue;
+				for (int j = 0; j < nb; j++) {
+					double added = w[B[j]][A[i]] + (j + 1 < nb ? w[A[i]][B[j + 1]] - w[B[j]][B[j + 1]] : 0);
+					double score = max(new_a, lengths[b] + added);
+					if (score < best.score) {
+						Move move = { RELOCATE, b, i, j, score };
+						best = move;
+					}
+				}
+			}
+			// swap A[i] and B[j]
+			for (int i = 1; i < na; i++) {
+				double out_a = around(w, A, i, A[i]);
+				for (int j = 1; j < nb; j++) {
+					double new_a = lengths[a] - out_a + around(w, A, i, B[j]);
+					double new_b = lengths[b] - around(w, B, j, B[j]) + around(w, B, j, A[i]);
+					double score = max(new_a, new_b);
+					if (score < best.score) {
+						Move move = { SWAP, b, i, j, score };
+						best = move;
+					}
+				}
+			}
+			// exchange the tails after A[i] and B[j]
+			partial_lengths(w, B, prefix_b, suffix_b);
+			for (int i = 0; i < na; i++) {
+				for (int j = 0; j < nb; j++) {
+					if (i + 1 == na && j + 1 == nb)
+						continue;
+					double new_a = prefix_a[i] + (j + 1 < nb ? w[A[i]][B[j + 1]] + suffix_b[j + 1] : 0);
+					double new_b = prefix_b[j] + (i + 1 < na ? w[B[j]][A[i + 1]] + suffix_a[i + 1] : 0);
+					double score = max(new_a, new_b);
+					if (score < best.score) {
+						Move move = { EXCHANGE_TAILS, b, i, j, score };
+						best = move;
+					}
+				}
+			}
+		}
+		if (best.type < 0)
+			break;
+
+		// apply
+		vector<int> &TA = tours[a];
+		vector<int> &TB = tours[best.b];
+		if (best.type == RELOCATE) {
+			int v = TA[best.i];
+			TA.erase(TA.begin() + best.i);
+			TB.insert(TB.begin() + best.j + 1, v);
+		}
+		else if (best.type == SWAP) {
+			swap(TA[best.i], TB[best.j]);
+		}
+		else {
+			vector<int> tail_a(TA.begin() + best.i + 1, TA.end());
+			vector<int> tail_b(TB.begin() + best.j + 1, TB.end());
+			TA.resize(best.i + 1);
+			TA.insert(TA.end(), tail_b.begin(), tail_b.end());
+			TB.resize(best.j + 1);
+			TB.insert(TB.end(), tail_a.begin(), tail_a.end());
+		}
+		improve(w, TA);
+		improve(w, TB);
+		lengths[a] = tour_length(w, TA);
+		lengths[best.b] = tour_length(w, TB);
+	}
+	return *max_element(lengths.begin(), lengths.end());
+}
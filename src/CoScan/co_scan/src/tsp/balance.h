@@ -0,0 +1,20 @@
+//==================================================================
+// File			: balance.h
+// Description	: Min-max balancing of open tours between robots
+//==================================================================
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+// Shrink the longest of several open tours. tours[r][0] is the fixed start
+// of robot r, the other entries are tasks, all indexing weights. Tasks move
+// between tours by relocate, swap and exchange of tails, each move lowers
+// the longer of the two tours it touches below the current longest one.
+// Changed tours are re-optimized by local_search_path. Stops when no move
+// helps or after time_budget seconds (0 = no limit). Returns the makespan.
+double balance_tours(const vector<vector<double> > &weights, vector<vector<int> > &tours, double time_budget = 0);
+
+// length of an open tour
+double tour_length(const vector<vector<double> > &weights, const vector<int> &tour);
@@ -0,0 +1,532 @@
+//==================================================================
+// File			: blossom.cpp
+// Description	: Minimum weight perfect matching (Edmonds blossom)
+//
+// Maximum weight matching with max cardinality, following Galil's
+// "Efficient algorithms for finding maximum matching in graphs" and
+// J. van Rantwijk's reference implementation. The minimum perfect
+// matching is the max cardinality matching of (maxw - w). Weights are
+// scaled to integers so duals and slacks stay exact.
+//==================================================================
+
+#include "blossom.h"
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace {
+
+typedef long long weight_t;
+
+class Matcher
+{
+public:
+	int nvertex, nedge;
+	vector<int> eu, ev;					// edge endpoints
+	vector<weight_t> ew;				// edge weights
+	vector<int> endpoint;				// endpoint[p] = vertex of edge p/2
+	vector<vector<int> > neighbend;		// endpoints leading out of a vertex
+	vector<int> mate;					// remote endpoint, -1 if single
+	vector<int> label;					// 0 free, 1 S, 2 T, 5 breadcrumb
+	vector<int> labelend;
+	vector<int> inblossom;
+	vector<int> blossomparent;
+	vector<vector<int> > blossomchilds;
+	vector<int> blossombase;
+	vector<vector<int> > blossomendps;
+	vector<int> bestedge;
+	vector<vector<int> > blossombestedges;
+	vector<char> hasbestedges;
+	vector<int> unusedblossoms;
+	vector<weight_t> dualvar;
+	vector<char> allowedge;
+	vector<int> queue;
+
+	Matcher(int n, const vector<int> &u, const vector<int> &v, const vector<weight_t> &w)
+	{
+		nvertex = n;
+		nedge = u.size();
+		eu = u; ev = v; ew = w;
+		weight_t maxweight = 0;
+		for (int k = 0; k < nedge; k++)
+			maxweight = max(maxweight, ew[k]);
+		endpoint.resize(2 * nedge);
+		neighbend.resize(nvertex);
+		for (int k = 0; k < nedge; k++) {
+			endpoint[2 * k] = eu[k];
+			endpoint[2 * k + 1] = ev[k];
+			neighbend[eu[k]].push_back(2 * k + 1);
+			neighbend[ev[k]].push_back(2 * k);
+		}
+		mate.assign(nvertex, -1);
+		label.assign(2 * nvertex, 0);
+		labelend.assign(2 * nvertex, -1);
+		inblossom.resize(nvertex);
+		for (int i = 0; i < nvertex; i++) inblossom[i] = i;
+		blossomparent.assign(2 * nvertex, -1);
+		blossomchilds.resize(2 * nvertex);
+		blossombase.assign(2 * nvertex, -1);
+		for (int i = 0; i < nvertex; i++) blossombase[i] = i;
+		blossomendps.resize(2 * nvertex);
+		bestedge.assign(2 * nvertex, -1);
+		blossombestedges.resize(2 * nvertex);
+		hasbestedges.assign(2 * nvertex, 0);
+		for (int b = nvertex; b < 2 * nvertex; b++) unusedblossoms.push_back(b);
+		dualvar.assign(2 * nvertex, 0);
+		for (int i = 0; i < nvertex; i++) dualvar[i] = maxweight;
+		allowedge.assign(nedge, 0);
+	}
+
+	weight_t slack(int k) { return dualvar[eu[k]] + dualvar[ev[k]] - 2 * ew[k]; }
+
+	void leaves(int b, vector<int> &out)
+	{
+		if (b < nvertex) { out.push_back(b); return; }
+		for (int i = 0; i < (int)blossomchilds[b].size(); i++)
+			leaves(blossomchilds[b][i], out);
+	}
+
+	void assignLabel(int w, int t, int p)
+	{
+		int b = inblossom[w];
+		label[w] = label[b] = t;
+		labelend[w] = labelend[b] = p;
+		bestedge[w] = bestedge[b] = -1;
+		if (t == 1) {
+			leaves(b, queue);
+		} else if (t == 2) {
+			int base = blossombase[b];
+			assignLabel(endpoint[mate[base]], 1, mate[base] ^ 1);
+		}
+	}
+
+	// trace back from v and w, return the base of a new blossom or -1 for an augmenting path
+	int scanBlossom(int v, int w)
+	{
+		vector<int> path;
+		int base = -1;
+		while (v != -1 || w != -1) {
+			int b = inblossom[v];
+			if (label[b] & 4) {
+				base = blossombase[b];
+				break;
+			}
+			path.push_back(b);
+			label[b] = 5;
+			if (labelend[b] == -1) {
+				v = -1;
+			} else {
+				v = endpoint[labelend[b]];
+				b = inblossom[v];
+				v = endpoint[labelend[b]];
+			}
+			if (w != -1)
+				swap(v, w);
+		}
+		for (int i = 0; i < (int)path.size(); i++)
+			label[path[i]] = 1;
+		return base;
+	}
+
+	void addBlossom(int base, int k)
+	{
+		int v = eu[k], w = ev[k];
+		int bb = inblossom[base];
+		int bv = inblossom[v];
+		int bw = inblossom[w];
+		int b = unusedblossoms.back();
+		unusedblossoms.pop_back();
+		blossombase[b] = base;
+		blossomparent[b] = -1;
+		blossomparent[bb] = b;
+		vector<int> &path = blossomchilds[b];
+		vector<int> &endps = blossomendps[b];
+		path.clear();
+		endps.clear();
+		while (bv != bb) {
+			blossomparent[bv] = b;
+			path.push_back(bv);
+			endps.push_back(labelend[bv]);
+			v = endpoint[labelend[bv]];
+			bv = inblossom[v];
+		}
+		path.push_back(bb);
+		reverse(path.begin(), path.end());
+		reverse(endps.begin(), endps.end());
+		endps.push_back(2 * k);
+		while (bw != bb) {
+			blossomparent[bw] = b;
+			path.push_back(bw);
+			endps.push_back(labelend[bw] ^ 1);
+			w = endpoint[labelend[bw]];
+			bw = inblossom[w];
+		}
+		label[b] = 1;
+		labelend[b] = labelend[bb];
+		dualvar[b] = 0;
+		vector<int> lv;
+		leaves(b, lv);
+		for (int i = 0; i < (int)lv.size(); i++) {
+			if (label[inblossom[lv[i]]] == 2)
+				queue.push_back(lv[i]);
+			inblossom[lv[i]] = b;
+		}
+		// least-slack edges to neighbouring S-blossoms
+		vector<int> bestedgeto(2 * nvertex, -1);
+		for (int c = 0; c < (int)path.size(); c++) {
+			int child = path[c];
+			vector<int> nblist;
+			if (!hasbestedges[child]) {
+				vector<int> cl;
+				leaves(child, cl);
+				for (int i = 0; i < (int)cl.size(); i++)
+					for (int j = 0; j < (int)neighbend[cl[i]].size(); j++)
+						nblist.push_back(neighbend[cl[i]][j] / 2);
+			} else {
+				nblist = blossombestedges[child];
+			}
+			for (int i = 0; i < (int)nblist.size(); i++) {
+				int e = nblist[i];
+				int j = ev[e];
+				if (inblossom[j] == b)
+					j = eu[e];
+				int bj = inblossom[j];
+				if (bj != b && label[bj] == 1 &&
+					(bestedgeto[bj] == -1 || slack(e) < slack(bestedgeto[bj])))
+					bestedgeto[bj] = e;
+			}
+			blossombestedges[child].clear();
+			hasbestedges[child] = 0;
+			bestedge[child] = -1;
+		}
+		blossombestedges[b].clear();
+		for (int i = 0; i < (int)bestedgeto.size(); i++)
+			if (bestedgeto[i] != -1)
+				blossombestedges[b].push_back(bestedgeto[i]);
+		hasbestedges[b] = 1;
+		bestedge[b] = -1;
+		for (int i = 0; i < (int)blossombestedges[b].size(); i++) {
+			int e = blossombestedges[b][i];
+			if (bestedge[b] == -1 || slack(e) < slack(bestedge[b]))
+				bestedge[b] = e;
+		}
+	}
+
+	void expandBlossom(int b, bool endstage)
+	{
+		vector<int> childs = blossomchilds[b];
+		for (int c = 0; c < (int)childs.size(); c++) {
+			int s = childs[c];
+			blossomparent[s] = -1;
+			if (s < nvertex) {
+				inblossom[s] = s;
+			} else if (endstage && dualvar[s] == 0) {
+				expandBlossom(s, endstage);
+			} else {
+				vector<int> lv;
+				leaves(s, lv);
+				for (int i = 0; i < (int)lv.size(); i++)
+					inblossom[lv[i]] = s;
+			}
+		}
+		// relabel the sub-blossoms of an expanded T-blossom
+		if (!endstage && label[b] == 2) {
+			int len = childs.size();
+			int entrychild = inblossom[endpoint[labelend[b] ^ 1]];
+			int j = find(childs.begin(), childs.end(), entrychild) - childs.begin();
+			int jstep, endptrick;
+			if (j & 1) {
+				j -= len;
+				jstep = 1;
+				endptrick = 0;
+			} else {
+				jstep = -1;
+				endptrick = 1;
+			}
+			vector<int> &endps = blossomendps[b];
+			int p = labelend[b];
+			while (j != 0) {
+				label[endpoint[p ^ 1]] = 0;
+				label[endpoint[endps[idx(j - endptrick, len)] ^ endptrick ^ 1]] = 0;
+				assignLabel(endpoint[p ^ 1], 2, p);
+				allowedge[endps[idx(j - endptrick, len)] / 2] = 1;
+				j += jstep;
+				p = endps[idx(j - endptrick, len)] ^ endptrick;
+				allowedge[p / 2] = 1;
+				j += jstep;
+			}
+			int bv = childs[idx(j, len)];
+			label[endpoint[p ^ 1]] = label[bv] = 2;
+			labelend[endpoint[p ^ 1]] = labelend[bv] = p;
+			bestedge[bv] = -1;
+			j += jstep;
+			while (childs[idx(j, len)] != entrychild) {
+				bv = childs[idx(j, len)];
+				if (label[bv] == 1) {
+					j += jstep;
+					continue;
+				}
+				vector<int> lv;
+				leaves(bv, lv);
+				int v = -1;
+				for (int i = 0; i < (int)lv.size(); i++) {
+					v = lv[i];
+					if (label[v] != 0)
+						break;
+				}
+				if (v != -1 && label[v] != 0) {
+					label[v] = 0;
+					label[endpoint[mate[blossombase[bv]]]] = 0;
+					assignLabel(v, 2, labelend[v]);
+				}
+				j += jstep;
+			}
+		}
+		label[b] = labelend[b] = -1;
+		blossomchilds[b].clear();
+		blossomendps[b].clear();
+		blossombase[b] = -1;
+		blossombestedges[b].clear();
+		hasbestedges[b] = 0;
+		bestedge[b] = -1;
+		unusedblossoms.push_back(b);
+	}
+
+	// python style negative index
+	static int idx(int j, int len) { return j < 0 ? j + len : j; }
+
+	// swap matched/unmatched edges inside b so that v becomes its base
+	void augmentBlossom(int b, int v)
+	{
+		int t = v;
+		while (blossomparent[t] != b)
+			t = blossomparent[t];
+		if (t >= nvertex)
+			augmentBlossom(t, v);
+		vector<int> &childs = blossomchilds[b];
+		vector<int> &endps = blossomendps[b];
+		int len = childs.size();
+		int i = find(childs.begin(), childs.end(), t) - childs.begin();
+		int j = i;
+		int jstep, endptrick;
+		if (i & 1) {
+			j -= len;
+			jstep = 1;
+			endptrick = 0;
+		} else {
+			jstep = -1;
+			endptrick = 1;
+		}
+		while (j != 0) {
+			j += jstep;
+			t = childs[idx(j, len)];
+			int p = endps[idx(j - endptrick, len)] ^ endptrick;
+			if (t >= nvertex)
+				augmentBlossom(t, endpoint[p]);
+			j += jstep;
+			t = childs[idx(j, len)];
+			if (t >= nvertex)
+				augmentBlossom(t, endpoint[p ^ 1]);
+			mate[endpoint[p]] = p ^ 1;
+			mate[endpoint[p ^ 1]] = p;
+		}
+		rotate(childs.begin(), childs.begin() + i, childs.end());
+		rotate(endps.begin(), endps.begin() + i, endps.end());
+		blossombase[b] = blossombase[childs[0]];
+	}
+
+	void augmentMatching(int k)
+	{
+		for (int side = 0; side < 2; side++) {
+			int s = side == 0 ? eu[k] : ev[k];
+			int p = side == 0 ? 2 * k + 1 : 2 * k;
+			while (true) {
+				int bs = inblossom[s];
+				if (bs >= nvertex)
+					augmentBlossom(bs, s);
+				mate[s] = p;
+				if (labelend[bs] == -1)
+					break;
+				int t = endpoint[labelend[bs]];
+				int bt = inblossom[t];
+				s = endpoint[labelend[bt]];
+				int j = endpoint[labelend[bt] ^ 1];
+				if (bt >= nvertex)
+					augmentBlossom(bt, j);
+				mate[j] = labelend[bt];
+				p = labelend[bt] ^ 1;
+			}
+		}
+	}
+
+	// max weight matching of max cardinality
+	void solve()
+	{
+		for (int stage = 0; stage < nvertex; stage++) {
+			label.assign(2 * nvertex, 0);
+			bestedge.assign(2 * nvertex, -1);
+			for (int b = nvertex; b < 2 * nvertex; b++) {
+				blossombestedges[b].clear();
+				hasbestedges[b] = 0;
+			}
+			allowedge.assign(nedge, 0);
+			queue.clear();
+			for (int v = 0; v < nvertex; v++)
+				if (mate[v] == -1 && label[inblossom[v]] == 0)
+					assignLabel(v, 1, -1);
+			bool augmented = false;
+			while (true) {
+				while (!queue.empty() && !augmented) {
+					int v = queue.back();
+					queue.pop_back();
+					for (int i = 0; i < (int)neighbend[v].size(); i++) {
+						int p = neighbend[v][i];
+						int k = p / 2;
+						int w = endpoint[p];
+						if (inblossom[v] == inblossom[w])
+							continue;
+						weight_t kslack = 0;
+						if (!allowedge[k]) {
+							kslack = slack(k);
+							if (kslack <= 0)
+								allowedge[k] = 1;
+						}
+						if (allowedge[k]) {
+							if (label[inblossom[w]] == 0) {
+								assignLabel(w, 2, p ^ 1);
+							} else if (label[inblossom[w]] == 1) {
+								int base = scanBlossom(v, w);
+								if (base >= 0) {
+									addBlossom(base, k);
+								} else {
+									augmentMatching(k);
+									augmented = true;
+									break;
+								}
+							} else if (label[w] == 0) {
+								label[w] = 2;
+								labelend[w] = p ^ 1;
+							}
+						} else if (label[inblossom[w]] == 1) {
+							int b = inblossom[v];
+							if (bestedge[b] == -1 || kslack < slack(bestedge[b]))
+								bestedge[b] = k;
+						} else if (label[w] == 0) {
+							if (bestedge[w] == -1 || kslack < slack(bestedge[w]))
+								bestedge[w] = k;
+						}
+					}
+				}
+				if (augmented)
+					break;
+
+				// dual update
+				int deltatype = -1, deltaedge = -1, deltablossom = -1;
+				weight_t delta = 0;
+				for (int v = 0; v < nvertex; v++) {
+					if (label[inblossom[v]] == 0 && bestedge[v] != -1) {
+						weight_t d = slack(bestedge[v]);
+						if (deltatype == -1 || d < delta) {
+							delta = d; deltatype = 2; deltaedge = bestedge[v];
+						}
+					}
+				}
+				for (int b = 0; b < 2 * nvertex; b++) {
+					if (blossomparent[b] == -1 && label[b] == 1 && bestedge[b] != -1) {
+						weight_t d = slack(bestedge[b]) / 2;
+						if (deltatype == -1 || d < delta) {
+							delta = d; deltatype = 3; deltaedge = bestedge[b];
+						}
+					}
+				}
+				for (int b = nvertex; b < 2 * nvertex; b++) {
+					if (blossombase[b] >= 0 && blossomparent[b] == -1 && label[b] == 2 &&
+						(deltatype == -1 || dualvar[b] < delta)) {
+						delta = dualvar[b]; deltatype = 4; deltablossom = b;
+					}
+				}
+				if (deltatype == -1) {
+					// no further improvement possible
+					deltatype = 1;
+					delta = dualvar[0];
+					for (int v = 1; v < nvertex; v++)
+						delta = min(delta, dualvar[v]);
+					delta = max(delta, (weight_t)0);
+				}
+				for (int v = 0; v < nvertex; v++) {
+					if (label[inblossom[v]] == 1)
+						dualvar[v] -= delta;
+					else if (label[inblossom[v]] == 2)
+						dualvar[v] += delta;
+				}
+				for (int b = nvertex; b < 2 * nvertex; b++) {
+					if (blossombase[b] >= 0 && blossomparent[b] == -1) {
+						if (label[b] == 1)
+							dualvar[b] += delta;
+						else if (label[b] == 2)
+							dualvar[b] -= delta;
+					}
+				}
+				if (deltatype == 1) {
+					break;
+				} else if (deltatype == 2) {
+					allowedge[deltaedge] = 1;
+					int i = eu[deltaedge];
+					if (label[inblossom[i]] == 0)
+						i = ev[deltaedge];
+					queue.push_back(i);
+				} else if (deltatype == 3) {
+					allowedge[deltaedge] = 1;
+					queue.push_back(eu[deltaedge]);
+				} else if (deltatype == 4) {
+					expandBlossom(deltablossom, false);
+				}
+			}
+			if (!augmented)
+				break;
+			// expand S-blossoms whose dual dropped to zero
+			for (int b = nvertex; b < 2 * nvertex; b++)
+				if (blossomparent[b] == -1 && blossombase[b] >= 0 && label[b] == 1 && dualvar[b] == 0)
+					expandBlossom(b, true);
+		}
+		for (int v = 0; v < nvertex; v++)
+			if (mate[v] >= 0)
+				mate[v] = endpoint[mate[v]];
+	}
+};
+
+}
+
+bool min_weight_perfect_matching(double **graph, const vector<int> &nodes, vector<int> &mate)
+{
+	int m = nodes.size();
+	mate.assign(m, -1);
+	if (m == 0)
+		return true;
+	if (m % 2)
+		return false;
+
+	// max weight of (maxc - c) == min weight, once every node is matched
+	double maxc = 0;
+	for (int a = 0; a < m; a++)
+		for (int b = a + 1; b < m; b++)
+			maxc = max(maxc, graph[nodes[a]][nodes[b]]);
+	// integer weights up to ~1e9 keep the duals exact
+	double scale = maxc > 0 ? 1e9 / maxc : 1;
+	vector<int> u, v;
+	vector<weight_t> w;
+	for (int a = 0; a < m; a++) {
+		for (int b = a + 1; b < m; b++) {
+			u.push_back(a);
+			v.push_back(b);
+			w.push_back((weight_t)llround((maxc - graph[nodes[a]][nodes[b]]) * scale) + 1);
+		}
+	}
+	Matcher matcher(m, u, v, w);
+	matcher.solve();
+	mate = matcher.mate;
+	for (int a = 0; a < m; a++)
+		if (mate[a] < 0)
+			return false;
+	return true;
+}
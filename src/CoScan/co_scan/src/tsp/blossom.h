@@ -0,0 +1,15 @@
+//==================================================================
+// File			: blossom.h
+// Description	: Minimum weight perfect matching (Edmonds blossom)
+//==================================================================
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+// Minimum weight perfect matching on the complete graph over nodes
+// Edge weight of nodes[a], nodes[b] is graph[nodes[a]][nodes[b]]
+// nodes.size() must be even. mate[a] is the index in nodes matched to a
+// Primal-dual blossom algorithm, O(m^3) for m nodes
+bool min_weight_perfect_matching(double **graph, const vector<int> &nodes, vector<int> &mate);
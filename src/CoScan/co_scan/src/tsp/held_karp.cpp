@@ -0,0 +1,89 @@
+//==================================================================
+// File			: held_karp.cpp
+// Description	: Exact open path by bitmask dynamic programming
+//==================================================================
+
+#include "held_karp.h"
+#include <float.h>
+#include <stdint.h>
+
+double held_karp_path(const vector<vector<double> > &weights, int start, int end, vector<int> &order)
+{
+	int n = weights.size();
+	order.clear();
+	if (n == 0 || n > held_karp_max_nodes || start < 0 || start >= n || end >= n || (end == start && n > 1))
+		return -1;
+	if (n == 1) {
+		order.push_back(start);
+		return 0;
+	}
+
+	// nodes other than start, bit i of a mask is others[i]
+	vector<int> others;
+	for (int v = 0; v < n; v++)
+		if (v != start)
+			others.push_back(v);
+	int m = others.size();
+	int full = (1 << m) - 1;
+
+	// dp[mask * m + j]: shortest path from start over mask, ending at others[j]
+	// float halves the table, lengths are summed in double at the end
+	vector<float> dp((size_t)(full + 1) * m, FLT_MAX);
+	vector<uint8_t> parent((size_t)(full + 1) * m, 0xff);
+	for (int j = 0; j < m; j++)
+		dp[(size_t)(1 << j) * m + j] = (float)weights[start][others[j]];
+
+	for (int mask = 1; mask <= full; mask++) {
+		for (int j = 0; j < m; j++) {
+			if (!(mask & (1 << j)))
+				continue;
+			float cur = dp[(size_t)mask * m + j];
+			if (cur == FLT_MAX)
+				continue;
+			const vector<double> &row = weights[others[j]];
+			for (int k = 0; k < m; k++) {
+				if (mask & (1 << k))
+					continue;
+				int next = mask | (1 << k);
+				float cand = cur + (float)row[others[k]];
+				if (cand < dp[(size_t)next * m + k]) {
+					dp[(size_t)next * m + k] = cand;
+					parent[(size_t)next * m + k] = j;
+				}
+			}
+		}
+	}
+
+	// best last node
+	int last = -1;
+	float best = FLT_MAX;
+	for (int j = 0; j < m; j++) {
+		if (end >= 0 && others[j] != end)
+			continue;
+		if (dp[(size_t)full * m + j] < best) {
+			best = dp[(size_t)full * m + j];
+			last = j;
+		}
+	}
+
+	if (last < 0)
+		return -1;
+
+	// walk back
+	vector<int> reversed;
+	int mask = full;
+	while (last != 0xff && mask) {
+		reversed.push_back(others[last]);
+		int prev = parent[(size_t)mask * m + last];
+		mask &= ~(1 << last);
+		last = prev;
+	}
+	order.push_back(start);
+	for (int i = reversed.size() - 1; i >= 0; i--)
+		order.push_back(reversed[i]);
+
+	double length = 0;
+	for (int i = 0; i + 1 < (int)order.size(); i++)
+		length += weights[order[i]][order[i + 1]];
+	return length;
+}
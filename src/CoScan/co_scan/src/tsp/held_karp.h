@@ -0,0 +1,17 @@
+//==================================================================
+// File			: held_karp.h
+// Description	: Exact open path by bitmask dynamic programming
+//==================================================================
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+// Largest node count solved exactly, the dp table is 2^(n-1) x (n-1)
+const int held_karp_max_nodes = 15;
+
+// Shortest open path over all nodes of weights, starting at start and,
+// if end >= 0, finishing at end. Visit order goes to order.
+// Returns the path length, or -1 if the set is too large.
+double held_karp_path(const vector<vector<double> > &weights, int start, int end, vector<int> &order);
@@ -0,0 +1,291 @@
+//==================================================================
+// File			: local_search.cpp
+// Description	: Or-2opt local search on candidate neighbour lists
+//==================================================================
+
+#include "local_search.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+// improvements below this are rounding noise
+static const double eps = 1e-9;
+
+void nearest_neighbors(double **graph, int n, int k, vector<vector<int> > &neighbors)
+{
+	neighbors.assign(n, vector<int>());
+	if (k > n - 1)
+		k = n - 1;
+	if (k <= 0)
+		return;
+	vector<int> order;
+	for (int a = 0; a < n; a++) {
+		order.clear();
+		for (int b = 0; b < n; b++)
+			if (b != a)
+				order.push_back(b);
+		double *row = graph[a];
+		partial_sort(order.begin(), order.begin() + k, order.end(),
+			[row](int x, int y) { return row[x] < row[y] || (row[x] == row[y] && x < y); });
+		neighbors[a].assign(order.begin(), order.begin() + k);
+	}
+}
+
+namespace {
+
+// array tour with node -> position lookup
+struct Tour
+{
+	vector<int> &t;
+	vector<int> pos;
+	int n;
+
+	Tour(vector<int> &path) : t(path), n(path.size())
+	{
+		pos.resize(n);
+		for (int i = 0; i < n; i++)
+			pos[t[i]] = i;
+	}
+	int next(int v) { return t[(pos[v] + 1) % n]; }
+	int prev(int v) { return t[(pos[v] - 1 + n) % n]; }
+
+	// reverse the tour from node b forward to node c
+	void reverse_path(int b, int c)
+	{
+		int i = pos[b], j = pos[c];
+		int len = (j - i + n) % n + 1;
+		// reversing the complement gives the same cycle, take the shorter side
+		if (2 * len > n) {
+			int nb = next(c), nc = prev(b);
+			i = pos[nb];
+			j = pos[nc];
+			len = n - len;
+		}
+		for (int s = 0; s < len / 2; s++) {
+			int ii = (i + s) % n, jj = (j - s + n) % n;
+			swap(t[ii], t[jj]);
+			pos[t[ii]] = ii;
+			pos[t[jj]] = jj;
+		}
+	}
+
+	// move segment s1..s2 (tour order) between c and next(c)
+	void move_segment(int s1, int s2, int c, bool reversed)
+	{
+		vector<int> seg;
+		for (int v = s1; ; v = next(v)) {
+			seg.push_back(v);
+			if (v == s2)
+				break;
+		}
+		if (reversed)
+			reverse(seg.begin(), seg.end());
+		vector<int> rest;
+		rest.reserve(n);
+		for (int v = next(s2); v != s1; v = next(v)) {
+			rest.push_back(v);
+			if (v == c)
+				rest.insert(rest.end(), seg.begin(), seg.end());
+		}
+		t.swap(rest);
+		for (int i = 0; i < n; i++)
+			pos[t[i]] = i;
+	}
+};
+
+// cost and fixed edges of the searched cycle. An open path is searched as a
+// cycle closed by a dummy node of zero cost; the dummy's edges to the fixed
+// endpoints are never removed, its edge to a free end moves freely.
+struct Costs
+{
+	double **graph;
+	int dummy;		// -1 for a closed tour
+	int start;		// fixed neighbours of dummy
+	int end;
+
+	double operator()(int a, int b) const
+	{
+		if (a == dummy || b == dummy)
+			return 0;
+		return graph[a][b];
+	}
+	bool fixed(int a, int b) const
+	{
+		if (dummy < 0)
+			return false;
+		if (b == dummy)
+			swap(a, b);
+		return a == dummy && (b == start || b == end);
+	}
+};
+
+double search(const Costs &w, Tour &tour, double &pathLength,
+	const vector<vector<int> > &neighbors, double time_budget, int max_moves)
+{
+	int n = tour.n;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+	// don't-look bits: queue of active nodes, the dummy never moves
+	vector<char> active(n, 0);
+	deque<int> queue;
+	for (int i = 0; i < n; i++) {
+		if (tour.t[i] != w.dummy) {
+			active[tour.t[i]] = 1;
+			queue.push_back(tour.t[i]);
+		}
+	}
+	int moves = 0;
+	int checks = 0;
+	while (!queue.empty()) {
+		if (max_moves > 0 && moves >= max_moves)
+			break;
+		if (time_budget > 0 && (++checks & 15) == 0 &&
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() > time_budget)
+			break;
+		int a = queue.front();
+		queue.pop_front();
+		active[a] = 0;
+		const vector<int> &na = neighbors[a];
+		vector<int> touched;
+		bool improved = false;
+
+		// 2-opt, both tour directions of the edge at a
+		for (int dir = 0; dir < 2 && !improved; dir++) {
+			int b = dir == 0 ? tour.next(a) : tour.prev(a);
+			if (w.fixed(a, b))
+				continue;
+			double ab = w(a, b);
+			for (int k = 0; k < (int)na.size(); k++) {
+				int c = na[k];
+				double ac = w(a, c);
+				// a-c must be shorter than a-b to pay off
+				if (ac >= ab - eps)
+					break;
+				int d = dir == 0 ? tour.next(c) : tour.prev(c);
+				if (c == b || d == a || w.fixed(c, d))
+					continue;
+				double delta = ac + w(b, d) - ab - w(c, d);
+				if (delta < -eps) {
+					if (dir == 0)
+						tour.reverse_path(b, c);
+					else
+						tour.reverse_path(c, b);
+					pathLength += delta;
+					touched.push_back(a); touched.push_back(b);
+					touched.push_back(c); touched.push_back(d);
+					improved = true;
+					break;
+				}
+			}
+		}
+
+		// Or-opt, segments starting or ending at a
+		for (int len = 1; len <= 3 && !improved; len++) {
+			for (int dir = 0; dir < 2 && !improved; dir++) {
+				// s1..s2 in tour order, a at one end
+				int s1 = a, s2 = a;
+				bool has_dummy = false;
+				for (int i = 1; i < len; i++) {
+					if (dir == 0) s2 = tour.next(s2);
+					else s1 = tour.prev(s1);
+					has_dummy = has_dummy || s1 == w.dummy || s2 == w.dummy;
+				}
+				int p = tour.prev(s1), nx = tour.next(s2);
+				if (has_dummy || p == s2 || nx == s1 || p == nx || w.fixed(p, s1) || w.fixed(s2, nx))
+					continue;
+				double remove_gain = w(p, s1) + w(s2, nx) - w(p, nx);
+				if (remove_gain <= eps)
+					continue;
+				// insert next to a candidate of an end node
+				for (int end = 0; end < 2 && !improved; end++) {
+					int s = end == 0 ? s1 : s2;
+					const vector<int> &ns = neighbors[s];
+					for (int k = 0; k < (int)ns.size(); k++) {
+						int c = ns[k];
+						if (w(s, c) >= remove_gain - eps)
+							break;
+						// c must be outside the segment
+						int ci = (tour.pos[c] - tour.pos[s1] + n) % n;
+						if (ci < len)
+							continue;
+						// try both edges of c
+						for (int side = 0; side < 2 && !improved; side++) {
+							int u = side == 0 ? c : tour.prev(c);
+							int v = tour.next(u);
+							if (u == p || v == s1 || u == s2 || w.fixed(u, v))
+								continue;
+							double uv = w(u, v);
+							double fwd = w(u, s1) + w(s2, v) - uv;
+							double rev = w(u, s2) + w(s1, v) - uv;
+							bool reversed = rev < fwd;
+							double delta = (reversed ? rev : fwd) - remove_gain;
+							if (delta < -eps) {
+								tour.move_segment(s1, s2, u, reversed);
+								pathLength += delta;
+								touched.push_back(p); touched.push_back(nx);
+								touched.push_back(s1); touched.push_back(s2);
+								touched.push_back(u); touched.push_back(v);
+								improved = true;
+							}
+						}
+						if (improved)
+							break;
+					}
+				}
+			}
+		}
+
+		if (improved) {
+			moves++;
+			for (int i = 0; i < (int)touched.size(); i++) {
+				int v = touched[i];
+				if (v != w.dummy && !active[v]) {
+					active[v] = 1;
+					queue.push_back(v);
+				}
+			}
+		}
+	}
+	return pathLength;
+}
+
+}
+
+double local_search(double **graph, vector<int> &path, double &pathLength,
+	const vector<vector<int> > &neighbors, double time_budget, int max_moves)
+{
+	int n = path.size();
+	if (n < 5) {
+		pathLength = 0;
+		for (int i = 0; i < n; i++)
+			pathLength += graph[path[i]][path[(i + 1) % n]];
+		return pathLength;
+	}
+	Costs w = { graph, -1, -1, -1 };
+	Tour tour(path);
+	return search(w, tour, pathLength, neighbors, time_budget, max_moves);
+}
+
+double local_search_path(double **graph, vector<int> &path, double &pathLength, bool fixed_end,
+	const vector<vector<int> > &neighbors, double time_budget, int max_moves)
+{
+	int n = path.size();
+	pathLength = 0;
+	for (int i = 0; i + 1 < n; i++)
+		pathLength += graph[path[i]][path[i + 1]];
+	if (n < 4)
+		return pathLength;
+	// close the path with the dummy node n
+	int start = path.front(), end = fixed_end ? path.back() : -1;
+	vector<int> cycle(path);
+	cycle.push_back(n);
+	Costs w = { graph, n, start, end };
+	Tour tour(cycle);
+	search(w, tour, pathLength, neighbors, time_budget, max_moves);
+	// unroll from start, away from the dummy
+	int i = tour.pos[start];
+	int step = tour.t[(i + n) % (n + 1)] == n ? 1 : -1;
+	for (int k = 0; k < n; k++)
+		path[k] = tour.t[(i + step * k + n + 1) % (n + 1)];
+	return pathLength;
+}
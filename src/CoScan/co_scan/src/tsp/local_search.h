@@ -0,0 +1,25 @@
+//==================================================================
+// File			: local_search.h
+// Description	: Or-2opt local search on candidate neighbour lists
+//==================================================================
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+// k cheapest other nodes of every node, ascending by cost
+void nearest_neighbors(double **graph, int n, int k, vector<vector<int> > &neighbors);
+
+// Improve a closed tour with 2-opt and Or-opt (segments of 1..3 nodes,
+// both orientations) moves. Only candidate neighbours are tried, nodes
+// whose surroundings did not change are skipped (don't-look bits).
+// Stops at a local optimum, after time_budget seconds or max_moves moves
+// (0 = no limit). Returns the new length, also stored in pathLength.
+double local_search(double **graph, vector<int> &path, double &pathLength,
+	const vector<vector<int> > &neighbors, double time_budget = 0, int max_moves = 0);
+
+// Same moves on an open path. path[0] stays first, path.back() stays last
+// if fixed_end, otherwise any node may end the path. Returns the open length.
+double local_search_path(double **graph, vector<int> &path, double &pathLength, bool fixed_end,
+	const vector<vector<int> > &neighbors, double time_budget = 0, int max_moves = 0);
@@ -0,0 +1,137 @@
+//==================================================================
+// File			: thread_pool.h
+// Description	: Reusable work-stealing pool of std::thread workers
+//==================================================================
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// workers live as long as the pool and are reused by every parallel_for.
+// each worker owns a deque, pops its own back and steals the front of others.
+class StealingPool
+{
+	struct Worker
+	{
+		std::deque<int> tasks;
+		std::mutex mutex;
+	};
+
+	std::vector<std::thread> m_threads;
+	std::vector<Worker*> m_workers;
+	std::function<void(int, int)> m_job;	// (task, worker)
+	std::atomic<int> m_pending;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned long m_generation = 0;
+	bool m_stop = false;
+
+	bool popLocal(int wid, int & task)
+	{
+		Worker* w = m_workers[wid];
+		std::lock_guard<std::mutex> lock(w->mutex);
+		if (w->tasks.empty())
+			return false;
+		task = w->tasks.back();
+		w->tasks.pop_back();
+		return true;
+	}
+
+	bool steal(int wid, int & task)
+	{
+		int num = m_workers.size();
+		for (int k = 1; k < num; k++)
+		{
+			Worker* w = m_workers[(wid + k) % num];
+			std::lock_guard<std::mutex> lock(w->mutex);
+			if (w->tasks.empty())
+				continue;
+			task = w->tasks.front();
+			w->tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	void loop(int wid)
+	{
+		unsigned long seen = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+				if (m_stop)
+					return;
+				seen = m_generation;
+			}
+			int task;
+			while (popLocal(wid, task) || steal(wid, task))
+			{
+				m_job(task, wid);
+				if (m_pending.fetch_sub(1) == 1)
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_done.notify_all();
+				}
+			}
+		}
+	}
+
+public:
+	StealingPool(int num)
+	{
+		if (num <= 0)
+			num = std::thread::hardware_concurrency();
+		if (num <= 0)
+			num = 1;
+		m_pending = 0;
+		for (int i = 0; i < num; i++)
+			m_workers.push_back(new Worker);
+		for (int i = 0; i < num; i++)
+			m_threads.push_back(std::thread(&StealingPool::loop, this, i));
+	}
+
+	~StealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (int i = 0; i < (int)m_threads.size(); i++)
+			m_threads[i].join();
+		for (int i = 0; i < (int)m_workers.size(); i++)
+			delete m_workers[i];
+	}
+
+	int size() { return m_workers.size(); }
+
+	// run job(task, worker) for task in [0, count), block until all finished.
+	// not reentrant, one parallel_for at a time.
+	void parallel_for(int count, std::function<void(int, int)> job)
+	{
+		if (count <= 0)
+			return;
+		m_job = job;
+		m_pending = count;
+		// deal tasks round robin, stealing evens out the uneven ones.
+		for (int t = 0; t < count; t++)
+		{
+			Worker* w = m_workers[t % m_workers.size()];
+			std::lock_guard<std::mutex> lock(w->mutex);
+			w->tasks.push_back(t);
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_generation++;
+		m_wake.notify_all();
+		m_done.wait(lock, [this] { return m_pending == 0; });
+		m_job = nullptr;
+	}
+};
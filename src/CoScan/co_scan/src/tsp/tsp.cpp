@@ -2,6 +2,9 @@
 
 #include "tsp.h"
 #include <float.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 struct thread_data {
 	int tid;
@@ -152,21 +155,7 @@ TSP::TSP(vector<Eigen::Vector2d> nodes, vector<vector<double>> weights){ //dsy
 	n = nodes.size();
 
 	/* Allocate memory */
-	graph = new double*[n];
-	for (int i = 0; i < n; i++) {
-		graph[i] = new double[n];
-		for (int j = 0; j < n; j++) graph[i][j] = 0;
-	}
-
-	cost = new double*[n];
-	for (int i = 0; i < n; i++) {
-		cost[i] = new double[n];
-	}
-
-	path_vals = new double*[n];
-	for (int i = 0; i < n; i++) {
-		path_vals[i] = new double[n];
-	}
+	alloc_graph();
 
 	/* Adjacency lsit */
 	adjlist = new vector<int>[n];
@@ -195,21 +184,7 @@ TSP::TSP(string in, string out){
 	getNodeCount();
 
 	// Allocate memory
-	graph = new double*[n];
-	for (int i = 0; i < n; i++) {
-		graph[i] = new double[n];
-		for (int j = 0; j < n; j++) graph[i][j] = 0;
-	}
-
-	cost = new double*[n];
-	for (int i = 0; i < n; i++) {
-		cost[i] = new double[n];
-	}
-
-	path_vals = new double*[n];
-	for (int i = 0; i < n; i++) {
-		path_vals[i] = new double[n];
-	}
+	alloc_graph();
 
 	// Adjacency lsit
 	adjlist = new vector<int> [n];
@@ -220,17 +195,18 @@ TSP::~TSP(){
 	// Destructor
 	/////////////////////////////////////////////////////
 
-	for (int i = 0; i < n; i++) {
-		delete [] graph[i];
-		delete [] cost[i];
-		delete [] path_vals[i];
-	}
-	delete [] path_vals;
 	delete [] graph;
-	delete [] cost;
 	delete [] adjlist;
 }
 
+void TSP::alloc_graph(){
+	// one row-major n x n block, graph[i] points at row i
+	weights_flat.assign((size_t)n * n, 0);
+	graph = new double*[n];
+	for (int i = 0; i < n; i++)
+		graph[i] = &weights_flat[(size_t)i * n];
+}
+
 void TSP::getNodeCount(){
 	int count = 0;
 	ifstream inStream;
@@ -411,43 +387,33 @@ void TSP::findMST_old() {
 	// In each iteration, we choose a minimum-weight
 	// edge (u, v), connecting a vertex v in the set A to
 	// the vertex u outside of set A
+	// Dense Prim, O(n^2) over contiguous rows: nodes in the tree
+	// get key = +inf so both loops run branch free
 	/////////////////////////////////////////////////////
-	double* key = new double[n];   // Key values used to pick minimum weight edge in cut
-	bool* in_mst = new bool[n];  // To represent set of vertices not yet included in MST
-	int* parent = new int[n];
-
-	// For each vertex v in V
-	for (int v = 0; v < n; v++) {
-		// Initialize all keys to infinity
-		//key[v] = std::numeric_limits<double>::max();
-		key[v] = DBL_MAX;
+	const double inf = std::numeric_limits<double>::infinity();
+	vector<double> key(n, inf);	// Key values used to pick minimum weight edge in cut
+	vector<double> bias(n, 0);	// +inf once a node is in the tree
+	vector<int> parent(n, -1);
 
-		// Mark as not being in mst yet
-		in_mst[v] = false;
-	}
-
-	// Node 0 is the root node so give it the lowest distance (key)
-	key[0] = 0;
-	parent[0] = -1; // First node is always root of MST
+	// Node 0 is the root node, first node is always root of MST
+	int v = 0;
+	bias[0] = inf;
+	key[0] = inf;
 
 	for (int i = 0; i < n - 1; i++) {
-		// Find closest remaining (not in tree) vertex
-		// TO DO : This would be better represented by heap/pqueue
-		int v = minKey(key, in_mst);
-
-		// Add vertex v to the MST
-		in_mst[v] = true;
-
-		// Look at each vertex u adjacent to v that's not yet in mst
+		// relax keys of nodes outside the tree through v
+		const double *row = graph[v];
 		for (int u = 0; u < n; u++) {
-			if (graph[v][u] && in_mst[u] == false && graph[v][u] < key[u]) {
-				// Update parent index of u
-				parent[u] = v;
-
-				// Update the key only if dist is smaller than key[u]
-				key[u] = graph[v][u];
-			}
+			double w = row[u] + bias[u];
+			bool closer = w < key[u];
+			key[u] = closer ? w : key[u];
+			parent[u] = closer ? v : parent[u];
 		}
+
+		// Find closest remaining (not in tree) vertex, add it to the MST
+		v = minKey(&key[0]);
+		bias[v] = inf;
+		key[v] = inf;
 	}
 
 	// map relations from parent array onto matrix
@@ -459,24 +425,27 @@ void TSP::findMST_old() {
 			adjlist[v2].push_back(v1);
 		}
 	}
-
-	delete[] key;
-	delete[] in_mst;
-	delete[] parent;
 };
 
-// findMST helper function
-int TSP::minKey(double key[], bool mstSet[]) {
-	// Initialize min value
-	//double min = std::numeric_limits<double>::max();
-	double min = DBL_MAX;
-	int min_index;
-	for (int v = 0; v < n; v++)
-		if (mstSet[v] == false && key[v] < min) {
-			min = key[v];
-			min_index = v;
-		}
-	return min_index;
+// findMST helper function, index of the smallest key
+int TSP::minKey(const double *key) {
+	double min = std::numeric_limits<double>::infinity();
+	int v = 0;
+#ifdef __SSE2__
+	// two lanes of minpd, then the first index holding the minimum
+	__m128d m = _mm_set1_pd(min);
+	for (; v + 2 <= n; v += 2)
+		m = _mm_min_pd(m, _mm_loadu_pd(key + v));
+	double lanes[2];
+	_mm_storeu_pd(lanes, m);
+	min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+#endif
+	for (; v < n; v++)
+		min = key[v] < min ? key[v] : min;
+	for (v = 0; v < n; v++)
+		if (key[v] == min)
+			return v;
+	return 0;
 };
 
 void TSP::findOdds() {
@@ -494,6 +463,40 @@ void TSP::findOdds() {
 }
 
 void TSP::perfect_matching() {
+	/////////////////////////////////////////////////////
+	// find a perfect matching M in the subgraph O
+	/////////////////////////////////////////////////////
+
+	// Find nodes with odd degrees in T to get subgraph O
+	findOdds();
+
+	if (matching_mode == MATCH_BLOSSOM)
+		perfect_matching_blossom();
+	else
+		perfect_matching_greedy();
+}
+
+void TSP::perfect_matching_blossom() {
+	/////////////////////////////////////////////////////
+	// minimum weight perfect matching on O, keeps the
+	// 1.5 approximation of Christofides
+	/////////////////////////////////////////////////////
+	vector<int> mate;
+	if (!min_weight_perfect_matching(graph, odds, mate)) {
+		cerr << "error in " << __FUNCTION__ << ", no perfect matching on " << odds.size() << " odd nodes, fall back to greedy" << endl;
+		perfect_matching_greedy();
+		return;
+	}
+	for (int a = 0; a < (int)odds.size(); a++) {
+		if (a < mate[a]) {
+			adjlist[odds[a]].push_back(odds[mate[a]]);
+			adjlist[odds[mate[a]]].push_back(odds[a]);
+		}
+	}
+	odds.clear();
+}
+
+void TSP::perfect_matching_greedy() {
 	/////////////////////////////////////////////////////
 	// find a perfect matching M in the subgraph O using greedy algorithm
 	// but not minimum
@@ -502,9 +505,6 @@ void TSP::perfect_matching() {
 	double length; 
 	std::vector<int>::iterator tmp, first;
 
-	// Find nodes with odd degrees in T to get subgraph O
-	findOdds();
-
 	// for each odd node
 	while (!odds.empty()) {
 		first = odds.begin();
@@ -528,87 +528,124 @@ void TSP::perfect_matching() {
 }
 
 
+void TSP::build_euler_graph() {
+	/////////////////////////////////////////////////////
+	// MST + matching as a flat multigraph: the edges of node v are
+	// adj_to[adj_begin[v] .. adj_begin[v+1]), adj_edge holds the edge id
+	// so parallel edges stay distinct
+	/////////////////////////////////////////////////////
+	adj_begin.assign(n + 1, 0);
+	for (int v = 0; v < n; v++)
+		adj_begin[v + 1] = adj_begin[v] + adjlist[v].size();
+	adj_to.resize(adj_begin[n]);
+	adj_edge.resize(adj_begin[n]);
+	vector<int> fill(adj_begin.begin(), adj_begin.end() - 1);
+	// adjlist holds every edge once from each end
+	int edges = 0;
+	for (int v = 0; v < n; v++) {
+		for (int k = 0; k < (int)adjlist[v].size(); k++) {
+			int u = adjlist[v][k];
+			if (u <= v)
+				continue;
+			adj_to[fill[v]] = u;
+			adj_edge[fill[v]++] = edges;
+			adj_to[fill[u]] = v;
+			adj_edge[fill[u]++] = edges;
+			edges++;
+		}
+	}
+	edge_count = edges;
+}
+
+void TSP::EulerBuffer::reserve(int nodes, int edges) {
+	cursor.resize(nodes);
+	visited.resize(nodes);
+	used.resize(edges);
+	stack.reserve(edges + 1);
+}
+
 // Take reference to a path vector
 // so can either modify actual euler path or a copy of it
 void TSP::euler (int pos, vector<int> &path) {
+	EulerBuffer buf;
+	euler(pos, path, buf);
+}
+
+void TSP::euler (int pos, vector<int> &path, EulerBuffer &buf) {
 	/////////////////////////////////////////////////////////
 	// Based on this algorithm:
 	//	http://www.graph-magics.com/articles/euler.php
 	// we know graph has 0 odd vertices, so start at any vertex
-	// O(V+E) complexity
+	// O(V+E) complexity, edges are marked used instead of copied out
 	/////////////////////////////////////////////////////////
-
-	// make copy of original adjlist to use/modify
-	vector<int> *temp = new vector<int> [n];
-	for (int i = 0; i < n; i++) {
-		temp[i].resize(adjlist[i].size());
-		temp[i] = adjlist[i];
-	}
+	if ((int)adj_begin.size() != n + 1)
+		build_euler_graph();
+	buf.reserve(n, edge_count);
+	for (int v = 0; v < n; v++)
+		buf.cursor[v] = adj_begin[v + 1];
+	std::fill(buf.used.begin(), buf.used.end(), 0);
 
 	path.clear();
+	buf.stack.clear();
 
 	// Repeat until the current vertex has no more neighbors and the stack is empty.
-	stack<int> stk;
-	while (!stk.empty() || temp[pos].size() > 0 ) {
+	while (true) {
+		// skip edges already walked from the other side
+		int &c = buf.cursor[pos];
+		while (c > adj_begin[pos] && buf.used[adj_edge[c - 1]])
+			c--;
 		// If current vertex has no neighbors -
-		if (temp[pos].size() == 0) {
+		if (c == adj_begin[pos]) {
 			// add it to circuit,
 			path.push_back(pos);
+			if (buf.stack.empty())
+				break;
 			// remove the last vertex from the stack and set it as the current one.
-			int last = stk.top();
-			stk.pop();
-			pos = last;
+			pos = buf.stack.back();
+			buf.stack.pop_back();
 		}
 		// Otherwise (in case it has neighbors)
 		else {
 			// add the vertex to the stack,
-			stk.push(pos);
-			// take any of its neighbors,
-			int neighbor = temp[pos].back();
-			// remove the edge between selected neighbor and that vertex,
-			temp[pos].pop_back();
-	        for (unsigned int i = 0; i < temp[neighbor].size(); i++)
-	            if (temp[neighbor][i] == pos) { // find position of neighbor in list
-	        	    temp[neighbor].erase (temp[neighbor].begin() + i); // remove it
-	                break;
-	            }
+			buf.stack.push_back(pos);
+			// take the last neighbor and mark the edge walked,
+			c--;
+			buf.used[adj_edge[c]] = 1;
 			// and set that neighbor as the current vertex.
-	        pos = neighbor;
+			pos = adj_to[c];
 		}
 	}
-	path.push_back(pos);
 }
 
 
 void TSP::make_hamilton(vector<int> &path, double &path_dist) {
-	// remove visited nodes from Euler tour
-	bool* visited = new bool[n]; // boolean value for each node if it has been visited yet
-	memset(visited, 0, n * sizeof(bool));
-
-	path_dist = 0;
+	EulerBuffer buf;
+	buf.visited.resize(n);
+	make_hamilton(path, path_dist, buf);
+}
 
-	int root = path.front();
-	vector<int>::iterator curr = path.begin();
-	vector<int>::iterator next = path.begin()+1;
-	visited[root] = true;
+void TSP::make_hamilton(vector<int> &path, double &path_dist, EulerBuffer &buf) {
+	// remove visited nodes from Euler tour, compacting in place
+	vector<char> &visited = buf.visited;
+	visited.assign(n, 0);
 
-	// loop until the end of the circuit list is reached
-	while ( next != path.end() ) {
+	path_dist = 0;
+	int kept = 0;
+	for (int i = 0; i < (int)path.size(); i++) {
+		int v = path[i];
 		// if we haven't been to the next city yet, go there
-		if (!visited[*next]) {
-			path_dist += graph[*curr][*next];
-			curr = next;
-			visited[*curr] = true;
-			next = curr + 1;
-		}else {
-			next = path.erase(next); // remove it
-		}
+		if (visited[v])
+			continue;
+		visited[v] = 1;
+		if (kept > 0)
+			path_dist += graph[path[kept - 1]][v];
+		path[kept++] = v;
 	}
+	path.resize(kept);
 
 	// add the distance back to the root
-	path_dist += graph[*curr][*next];
-	
-	delete[] visited;
+	if (kept > 1)
+		path_dist += graph[path[kept - 1]][path.front()];
 }
 
 
@@ -622,40 +659,218 @@ void TSP::create_tour(int pos){
 	// make it hamiltonian
 	// pass actual vars
 	make_hamilton(circuit, pathLength);
+
+	if (open_path)
+		cut_path(circuit, pathLength);
+}
+
+
+void TSP::cut_path(vector<int> &path, double &length) {
+	/////////////////////////////////////////////////////
+	// Turn a closed tour into an open path from path_start,
+	// ending at path_end if set. Keeps the cheaper direction.
+	/////////////////////////////////////////////////////
+	int size = path.size();
+	int s = find(path.begin(), path.end(), path_start) - path.begin();
+	if (s == size)
+		return;
+	double best = DBL_MAX;
+	vector<int> candidate, result;
+	for (int dir = 0; dir < 2; dir++) {
+		candidate.clear();
+		for (int k = 0; k < size; k++)
+			candidate.push_back(path[(s + (dir == 0 ? k : size - k) + size) % size]);
+		// the end moves from its place in the tour to the back
+		if (path_end >= 0 && path_end != path_start) {
+			candidate.erase(find(candidate.begin(), candidate.end(), path_end));
+			candidate.push_back(path_end);
+		}
+		double cost = 0;
+		for (int k = 0; k + 1 < size; k++)
+			cost += graph[candidate[k]][candidate[k + 1]];
+		if (cost < best) {
+			best = cost;
+			result.swap(candidate);
+		}
+	}
+	path.swap(result);
+	length = best;
 }
 
 
 // Does euler and hamilton but doesn't modify any variables
 // Just finds path length from the node specified and returns it
-int TSP::find_best_path (int pos) {
+double TSP::find_best_path (int pos) {
+
+	if ((int)neighbors.size() != n)
+		build_neighbors();
 
 	// create new vector to pass to euler function
 	vector<int>path;
-	euler(pos, path);
+	EulerBuffer buf;
+	return find_best_path(pos, path, buf);
+}
+
+// Same, but builds the tour in the caller's buffers
+// Only reads graph and the euler graph, so it is safe to call from several threads
+double TSP::find_best_path (int pos, vector<int> &path, EulerBuffer &buf) {
+
+	euler(pos, path, buf);
 
 	// make it hamiltonian, pass copy of vars
 	double length;
-	make_hamilton(path, length);
+	make_hamilton(path, length, buf);
 
 	// Optimize
-	twoOpt(graph, path, length, n);
-	twoOpt(graph, path, length, n);
-	twoOpt(graph, path, length, n);
-	twoOpt(graph, path, length, n);
-	twoOpt(graph, path, length, n);
+	if (open_path) {
+		cut_path(path, length);
+		local_search_path(graph, path, length, path_end >= 0, neighbors, search_time, search_moves);
+	}
+	else {
+		local_search(graph, path, length, neighbors, search_time, search_moves);
+	}
 
 	return length;
 }
 
+void TSP::build_neighbors() {
+	// candidate lists, shared read-only by all starts
+	nearest_neighbors(graph, n, neighbor_k, neighbors);
+}
+
+// Non-negative doubles compare like their bit patterns,
+// so the best length can be reduced with integer compare-exchange
+static uint64_t length_bits(double length) {
+	uint64_t bits;
+	memcpy(&bits, &length, sizeof(bits));
+	return bits;
+}
+
+int TSP::multi_start(int increment, StealingPool &pool) {
+	/////////////////////////////////////////////////////
+	// Run find_best_path from every increment-th node on the pool,
+	// keep the shortest tour in circuit & pathLength, return its start node
+	/////////////////////////////////////////////////////
+	if (increment < 1)
+		increment = 1;
+	int starts = (n + increment - 1) / increment;
+	if ((int)neighbors.size() != n)
+		build_neighbors();
+	// shared read-only by the workers
+	build_euler_graph();
+
+	// per worker tour buffers, no allocation or locking between starts
+	struct TourBuffer {
+		vector<int> path;
+		vector<int> best;
+		EulerBuffer euler;
+		double length;
+		int start;
+	};
+	vector<TourBuffer> buffers(pool.size());
+	for (int i = 0; i < (int)buffers.size(); i++) {
+		buffers[i].path.reserve(adj_to.size() + 1);
+		buffers[i].euler.reserve(n, edge_count);
+		buffers[i].length = DBL_MAX;
+		buffers[i].start = -1;
+	}
+
+	// lock-free reduction of the best length over all workers
+	std::atomic<uint64_t> best_bits(length_bits(DBL_MAX));
+	pool.parallel_for(starts, [&](int task, int worker) {
+		TourBuffer &buf = buffers[worker];
+		int pos = task * increment;
+		double length = find_best_path(pos, buf.path, buf.euler);
+		// exact ties go to the lower start node, independent of scheduling
+		if (length < buf.length || (length == buf.length && pos < buf.start)) {
+			buf.length = length;
+			buf.start = pos;
+			buf.best.swap(buf.path);
+		}
+		uint64_t bits = length_bits(length);
+		uint64_t cur = best_bits.load();
+		while (bits < cur && !best_bits.compare_exchange_weak(cur, bits));
+		if (DEBUG) cout << "worker " << setw(4) << left << worker << " start " << setw(6) << left << pos
+			<< " result: " << length << endl;
+	});
+
+	// the winning workers still hold their tours
+	uint64_t bits = best_bits.load();
+	int best = -1;
+	for (int i = 0; i < (int)buffers.size(); i++) {
+		if (buffers[i].start >= 0 && length_bits(buffers[i].length) == bits &&
+			(best < 0 || buffers[i].start < buffers[best].start))
+			best = i;
+	}
+	if (best < 0)
+		return -1;
+	circuit = buffers[best].best;
+	pathLength = buffers[best].length;
+	return buffers[best].start;
+}
+
 
 void TSP::make_shorter(){
 	// Modify circuit & pathLength
-	twoOpt(graph, circuit, pathLength, n);
+	if ((int)neighbors.size() != n)
+		build_neighbors();
+	if (open_path)
+		local_search_path(graph, circuit, pathLength, path_end >= 0, neighbors, search_time, search_moves);
+	else
+		local_search(graph, circuit, pathLength, neighbors, search_time, search_moves);
 }
 
 
 
 
+//================================ INSTANCE FILES ================================//
+
+// Instance format: n, then n lines "x y", then the n x n weights row by row
+// Several instances may follow each other in one file
+bool TSP::save_instance(string path) {
+	ofstream ofs(path.c_str(), ios::app);
+	if (!ofs) {
+		cerr << "error in " << __FUNCTION__ << ", can't open " << path << endl;
+		return false;
+	}
+	ofs << setprecision(17) << n << endl;
+	for (int i = 0; i < n; i++)
+		ofs << cities[i].x << " " << cities[i].y << endl;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++)
+			ofs << graph[i][j] << (j + 1 < n ? " " : "");
+		ofs << endl;
+	}
+	ofs.close();
+	return true;
+}
+
+bool TSP::load_instances(string path, vector<vector<Eigen::Vector2d> > &nodes, vector<vector<vector<double> > > &weights) {
+	ifstream ifs(path.c_str());
+	if (!ifs) {
+		cerr << "error in " << __FUNCTION__ << ", can't open " << path << endl;
+		return false;
+	}
+	int num;
+	while (ifs >> num) {
+		vector<Eigen::Vector2d> ns(num);
+		vector<vector<double> > ws(num, vector<double>(num));
+		for (int i = 0; i < num; i++)
+			ifs >> ns[i].x() >> ns[i].y();
+		for (int i = 0; i < num; i++)
+			for (int j = 0; j < num; j++)
+				ifs >> ws[i][j];
+		if (!ifs) {
+			cerr << "error in " << __FUNCTION__ << ", truncated instance in " << path << endl;
+			return false;
+		}
+		nodes.push_back(ns);
+		weights.push_back(ws);
+	}
+	return true;
+}
+
+
 //================================ PRINT FUNCTIONS ================================//
 
 void TSP::printResult(){
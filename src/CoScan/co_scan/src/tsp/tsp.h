@@ -20,6 +20,7 @@
 #include <iostream>
 #include <limits>
 #include <pthread.h>
+#include <stdint.h>
 #include <queue>
 #include <stack>
 #include <string>
@@ -27,9 +28,12 @@
 #include <vector>
 
 #include "twoOpt.h"
+#include "thread_pool.h"
+#include "blossom.h"
+#include "local_search.h"
 
-// Eigen
-#include <Eigen/Dense> 
+// Eigen
+#include <Eigen/Dense> 
 #include <Eigen/src/Geometry/Quaternion.h>
 
 //#include "../Global.h"
@@ -43,6 +47,13 @@ using namespace std;
 // Number of threads to use to fill N x N cost matrix
 #define THREADS 1
 
+// Matching of odd MST vertices
+enum MatchingMode
+{
+	MATCH_GREEDY = 0,	// nearest neighbour pairs, fast but no bound
+	MATCH_BLOSSOM = 1	// minimum weight perfect matching
+};
+
 // Calcualte lowest index controlled by thread id
 #define START_AT(id,p,n) ((id)*(n)/(p))
 
@@ -71,9 +82,14 @@ private:
 	// List of odd nodes
 	vector<int>odds;
 
-	// Smaller cost matrix used to store distances between odd nodes
-	// Used to find minimum matching on odd nodes
-	double **cost; // dsy: maybe useless 
+	// Row-major n x n storage behind graph
+	vector<double> weights_flat;
+
+	// MST + matching multigraph for euler, see build_euler_graph
+	vector<int> adj_begin;
+	vector<int> adj_to;
+	vector<int> adj_edge;
+	int edge_count = 0;
 
 	// Initialization function
 	void getNodeCount();
@@ -81,8 +97,11 @@ private:
 	// Find odd vertices in graph
 	void findOdds();
 
+	// Allocate graph rows inside weights_flat
+	void alloc_graph();
+
 	// Prim helper function
-	int minKey(double key[], bool mstSet[]);
+	int minKey(const double *key);
 
 
 protected:
@@ -99,6 +118,7 @@ public:
 	vector<City>cities;
 
 	// Full n x n cost matrix of distances between each city
+	// Rows point into one contiguous block, read-only once solving starts
 	double **graph;
 
 	// Current shortest path length
@@ -114,9 +134,23 @@ public:
 
 	int end_idx[THREADS];
 
-	// n x 2 array to store length of TSP path starting at each node
-	// col 0 => starting index   col 1 => path length from that node
-	double **path_vals;
+	// MatchingMode used by perfect_matching
+	int matching_mode = MATCH_BLOSSOM;
+
+	// Open path instead of a closed tour: circuit starts at path_start
+	// and, if path_end >= 0, finishes at path_end. pathLength has no return leg
+	bool open_path = false;
+	int path_start = 0;
+	int path_end = -1;
+
+	// Local search: candidate list size, and budget per tour
+	// in seconds and improving moves (0 => until local optimum)
+	int neighbor_k = 10;
+	double search_time = 0;
+	int search_moves = 0;
+
+	// k nearest nodes of each node, see build_neighbors
+	vector<vector<int> > neighbors;
 
 	// Constructor
 	TSP(string in, string out);
@@ -141,23 +175,53 @@ public:
 
 	// Find perfect matching
 	void perfect_matching();
+	void perfect_matching_greedy();
+	void perfect_matching_blossom();
+
+	// Scratch arrays of euler and make_hamilton, one per thread
+	struct EulerBuffer
+	{
+		vector<int> cursor;		// next unwalked slot of each node
+		vector<char> used;		// walked edges
+		vector<int> stack;
+		vector<char> visited;
+		void reserve(int nodes, int edges);
+	};
 
 	// Find best node to start euler at
 	// Doesn't create tour, just checks
-	int find_best_path(int);
+	double find_best_path(int);
+	double find_best_path(int, vector<int> &, EulerBuffer &);
+
+	// Try every increment-th node as euler start on the caller's thread pool
+	// Keeps the shortest tour (or open path) in circuit, returns its euler start node
+	int multi_start(int increment, StealingPool &pool);
 
 	// Create tour starting at specified node
 	void create_tour(int);
 
+	// Cut a closed tour into the open path, see open_path
+	void cut_path(vector<int> &path, double &length);
+
 	// Private functions implemented by create_tour() and find_best_path()
+	void build_euler_graph();
 	void euler (int pos, vector<int> &);
+	void euler (int pos, vector<int> &, EulerBuffer &);
 	//void euler(int);
 	void make_hamilton(vector<int> &, double&);
+	void make_hamilton(vector<int> &, double&, EulerBuffer &);
+
+	// Candidate lists for local search
+	void build_neighbors();
 
-	// Calls twoOpt function
+	// Runs local search on circuit
 	void make_shorter();
 
 
+	// Instance files, used to replay recorded task sets
+	bool save_instance(string path);
+	static bool load_instances(string path, vector<vector<Eigen::Vector2d> > &nodes, vector<vector<vector<double> > > &weights);
+
 	// Debugging functions
 	void printCities();
 	void printAdjList();
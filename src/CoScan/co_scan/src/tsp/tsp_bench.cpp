@@ -0,0 +1,72 @@
+//==================================================================
+// File			: tsp_bench.cpp
+// Description	: Tour length and runtime of the TSP solver modes on
+//				  task sets recorded by co_scan --record <path> (<path>.tsp)
+//==================================================================
+
+#include "tsp.h"
+#include <chrono>
+
+// same pipeline as Navigation::TSP_path, open path length from node 0 and seconds
+static double solve(vector<Eigen::Vector2d> &nodes, vector<vector<double> > &weights, int mode, StealingPool &pool, double &seconds) {
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	TSP tsp(nodes, weights);
+	tsp.matching_mode = mode;
+	tsp.open_path = true;
+	tsp.path_start = 0;
+	tsp.findMST_old();
+	tsp.perfect_matching();
+	tsp.multi_start(1, pool);
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return tsp.pathLength;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Usage: tsp_bench [-t threads] <path>.tsp ...\n");
+		printf("compares greedy and blossom matching on recorded task sets\n");
+		return -1;
+	}
+	int threads = 0;
+	vector<vector<Eigen::Vector2d> > nodes;
+	vector<vector<vector<double> > > weights;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+			continue;
+		}
+		if (!TSP::load_instances(argv[i], nodes, weights))
+			return -1;
+	}
+
+	StealingPool pool(threads);
+	const char* names[2] = { "greedy", "blossom" };
+	double total_len[2] = { 0, 0 }, total_sec[2] = { 0, 0 };
+	int better = 0, worse = 0, solved = 0;
+	printf("%6s %6s %12s %10s %12s %10s %8s\n", "set", "n", "greedy", "sec", "blossom", "sec", "gain%");
+	for (int k = 0; k < (int)nodes.size(); k++) {
+		// TSP_path answers these directly
+		if (nodes[k].size() <= 3)
+			continue;
+		double len[2], sec[2];
+		for (int mode = 0; mode < 2; mode++) {
+			len[mode] = solve(nodes[k], weights[k], mode, pool, sec[mode]);
+			total_len[mode] += len[mode];
+			total_sec[mode] += sec[mode];
+		}
+		if (len[MATCH_BLOSSOM] < len[MATCH_GREEDY] - 1e-9) better++;
+		if (len[MATCH_BLOSSOM] > len[MATCH_GREEDY] + 1e-9) worse++;
+		solved++;
+		printf("%6d %6d %12.3f %10.4f %12.3f %10.4f %8.2f\n", k, (int)nodes[k].size(),
+			len[MATCH_GREEDY], sec[MATCH_GREEDY], len[MATCH_BLOSSOM], sec[MATCH_BLOSSOM],
+			100.0 * (len[MATCH_GREEDY] - len[MATCH_BLOSSOM]) / max(len[MATCH_GREEDY], 1e-9));
+	}
+	if (solved == 0) {
+		printf("no task set with more than 3 nodes\n");
+		return 0;
+	}
+	printf("\n%d task sets, blossom shorter on %d, longer on %d\n", solved, better, worse);
+	for (int mode = 0; mode < 2; mode++)
+		printf("%8s: total length %.3f, total time %.4f s\n", names[mode], total_len[mode], total_sec[mode]);
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include "vis_sink.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+
+VisSink::VisSink(size_t capacity) : m_queue(capacity), m_dropped(0)
+{
+	m_worker = std::thread(&VisSink::run, this);
+}
+
+VisSink::~VisSink()
+{
+	m_queue.close();
+	m_worker.join();
+	if (m_dropped > 0)
+		std::cerr << "vis sink: " << m_dropped << " images dropped" << std::endl;
+}
+
+bool VisSink::post(int level, const std::string & path, Render render, const std::string & window)
+{
+	if (!enabled(level))
+		return false;
+	Job* job = new Job();
+	job->path = path;
+	job->window = window;
+	job->render = render;
+	if (!m_queue.try_push(job))
+	{
+		delete job;
+		m_dropped++;
+		return false;
+	}
+	return true;
+}
+
+// render, encode and show in order. windows are only touched by this thread
+void VisSink::run()
+{
+	Job* job = NULL;
+	while (m_queue.pop(job))
+	{
+		cv::Mat image = job->render();
+		if (!image.empty())
+		{
+			if (!job->path.empty())
+				cv::imwrite(job->path, image);
+			if (!job->window.empty())
+			{
+				cv::imshow(job->window, image);
+				cv::waitKey(1);
+			}
+		}
+		delete job;
+	}
+}
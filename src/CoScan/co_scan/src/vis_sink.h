@@ -0,0 +1,53 @@
+#pragma once
+// std
+#include <string>
+#include <thread>
+#include <functional>
+#include <atomic>
+// opencv
+#include <opencv2/core/core.hpp>
+// other headers
+#include "global.h"
+#include "bounded_queue.h"
+
+// debug image levels, g_vis_level selects up to which level images are made
+enum VisLevel
+{
+	VIS_OFF = 0,		// nothing
+	VIS_SUMMARY = 1,	// one plan image per round
+	VIS_FULL = 2		// plus intermediate maps and every scan waypoint
+};
+
+// debug images off the planning and scan threads. a job renders an image and writes it
+// to a png and/or shows it in a window on the sink thread. when the queue is full the
+// job is dropped, callers never wait. renders must only use what they captured.
+class VisSink
+{
+public:
+	typedef std::function<cv::Mat()> Render;
+
+	VisSink(size_t capacity = 8);
+	~VisSink(); // remaining jobs are finished
+
+	// images of this level are wanted. check before capturing data for a job
+	bool enabled(int level) const { return level > VIS_OFF && level <= g_vis_level; }
+
+	// queue render, then write path and show in window when not empty. false if not enabled or dropped
+	bool post(int level, const std::string & path, Render render, const std::string & window = "");
+
+	// jobs dropped on a full queue so far
+	int dropped() const { return m_dropped; }
+
+private:
+	struct Job
+	{
+		std::string path;
+		std::string window;
+		Render render;
+	};
+	BoundedQueue<Job*> m_queue;
+	std::atomic<int> m_dropped;
+	std::thread m_worker;
+
+	void run();
+};
@@ -25,6 +25,8 @@
 #include <sys/wait.h> 
 #include <pthread.h>
 #include <netinet/tcp.h>
+#include <errno.h>
+#include <time.h>
 
 using namespace std;
 
@@ -53,9 +55,21 @@ vector<cv::Mat> crt_depth_images(rbtnum);
 // subscribers
 vector<image_transport::Subscriber> subsColor(rbtnum);
 vector<image_transport::Subscriber> subsDepth(rbtnum);
+// latest frame slots: callbacks stamp and signal, socket threads wait for frames newer than the last move.
+pthread_mutex_t frame_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t frame_cond = PTHREAD_COND_INITIALIZER;
+vector<ros::Time> crt_rgb_stamps(rbtnum);
+vector<ros::Time> crt_depth_stamps(rbtnum);
+ros::Time last_move_stamp;
+const double frame_wait_timeout = 3.0; // seconds, fall back to latest frames after this
 
 ros::ServiceClient gclient;
 ros::ServiceClient sclient;
+// per robot pose clients, so the calls of all robots are in flight together.
+vector<ros::ServiceClient> gclients;
+vector<ros::ServiceClient> sclients;
+// last pose got of each robot, empty if none yet.
+vector< vector<float> > known_poses;
 float pose[7];
 bool pose_ready = false;
 
@@ -108,9 +122,17 @@ void rgbImageCallback(const sensor_msgs::ImageConstPtr& msg, const std::string &
     catch(cv_bridge::Exception& e)
     {
         ROS_ERROR("cv_bridge exception: %s", e.what());
+        return;
     }
 
-    crt_rgb_images[rbtIndex] = rgbPass; 
+    pthread_mutex_lock(&frame_mutex);
+    if (rbtIndex < crt_rgb_images.size())
+    {
+        crt_rgb_images[rbtIndex] = rgbPass; 
+        crt_rgb_stamps[rbtIndex] = msg->header.stamp;
+    }
+    pthread_cond_broadcast(&frame_cond);
+    pthread_mutex_unlock(&frame_mutex);
 }
 
 // depth frame callback. 2018-09-10. no mem leak. 2018-09-19.
@@ -131,6 +153,7 @@ void depthImageCallback(const sensor_msgs::ImageConstPtr& msg, const std::string
     catch(cv_bridge::Exception& e)
     {
         ROS_ERROR("cv_bridge exception: %s", e.what());
+        return;
     }
 
     cv::Mat shortPass(480, 640, CV_16UC1); 
@@ -142,7 +165,58 @@ void depthImageCallback(const sensor_msgs::ImageConstPtr& msg, const std::string
             shortPass.ptr<short>(i)[j] = (short)(depthImg.ptr<float>(i)[j] * 1000); 
         }
     }
-    crt_depth_images[rbtIndex] = shortPass; 
+    pthread_mutex_lock(&frame_mutex);
+    if (rbtIndex < crt_depth_images.size())
+    {
+        crt_depth_images[rbtIndex] = shortPass; 
+        crt_depth_stamps[rbtIndex] = msg->header.stamp;
+    }
+    pthread_cond_broadcast(&frame_cond);
+    pthread_mutex_unlock(&frame_mutex);
+}
+
+// frames taken before this moment are stale.
+void markMoved()
+{
+    pthread_mutex_lock(&frame_mutex);
+    last_move_stamp = ros::Time::now();
+    pthread_mutex_unlock(&frame_mutex);
+}
+
+// wait until every robot has rgb and depth newer than the last move, then take the frames.
+bool waitForFrames(vector<cv::Mat> & rgbs, vector<cv::Mat> & depths)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)frame_wait_timeout;
+    deadline.tv_nsec += (long)((frame_wait_timeout - (time_t)frame_wait_timeout) * 1e9);
+    if (deadline.tv_nsec >= 1000000000) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000; }
+
+    bool fresh = false;
+    pthread_mutex_lock(&frame_mutex);
+    while (true)
+    {
+        fresh = true;
+        for (int rid = 0; rid < rbtnum; ++rid)
+        {
+            if (crt_rgb_stamps[rid] <= last_move_stamp || crt_depth_stamps[rid] <= last_move_stamp)
+            {
+                fresh = false;
+                break;
+            }
+        }
+        if (fresh) break;
+        if (pthread_cond_timedwait(&frame_cond, &frame_mutex, &deadline) == ETIMEDOUT)
+        {
+            printf("wait for frames timeout, send latest frames.\n");
+            break;
+        }
+    }
+    // callbacks replace the mats, so the headers stay valid after unlock.
+    rgbs = crt_rgb_images;
+    depths = crt_depth_images;
+    pthread_mutex_unlock(&frame_mutex);
+    return fresh;
 }
 
 // pose
@@ -190,13 +264,178 @@ void setForPose(int id, float x, float y, float z, float qx, float qy, float qz,
         modelstate.pose = posemsg;
         modelstate.model_name = (std::string) s;
     setmodelstate.request.model_state = modelstate;
-    if (sclient.call(setmodelstate)){}
+    if (sclient.call(setmodelstate))
+        markMoved();
     else
         ROS_ERROR("Failed to call service");
 
     printf(" succeed.\n");
 }
 
+// one pose service call of one robot, run in its own thread.
+struct PoseCall
+{
+    int id;
+    float* pose; // 7 floats: x y z qx qy qz qw
+    bool ok;
+};
+
+// persistent per robot clients, (re)connected on demand.
+void connectPoseClients(int id)
+{
+    ros::NodeHandle n;
+    if (!gclients[id].isValid())
+        gclients[id] = n.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state", true);
+    if (!sclients[id].isValid())
+        sclients[id] = n.serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state", true);
+}
+
+// pose clients for every robot.
+void resetPoseClients()
+{
+    gclients.clear();
+    gclients.resize(rbtnum);
+    sclients.clear();
+    sclients.resize(rbtnum);
+    known_poses.clear();
+    known_poses.resize(rbtnum);
+    for (int rid = 0; rid < rbtnum; ++rid)
+        connectPoseClients(rid);
+}
+
+void *getPoseThread(void *ptr)
+{
+    PoseCall* call = (PoseCall*)ptr;
+    gazebo_msgs::GetModelState getmodelstate;
+    char s[20];
+    sprintf(s, "robot_%d", call->id);
+    getmodelstate.request.model_name = (std::string) s;
+    connectPoseClients(call->id);
+    call->ok = gclients[call->id].call(getmodelstate);
+    if (!call->ok)
+    {
+        ROS_ERROR("Failed to call service get_model_state for %s", s);
+        return 0;
+    }
+    call->pose[0] = getmodelstate.response.pose.position.x;
+    call->pose[1] = getmodelstate.response.pose.position.y;
+    call->pose[2] = getmodelstate.response.pose.position.z;
+    call->pose[3] = getmodelstate.response.pose.orientation.x;
+    call->pose[4] = getmodelstate.response.pose.orientation.y;
+    call->pose[5] = getmodelstate.response.pose.orientation.z;
+    call->pose[6] = getmodelstate.response.pose.orientation.w;
+    return 0;
+}
+
+void *setPoseThread(void *ptr)
+{
+    PoseCall* call = (PoseCall*)ptr;
+    gazebo_msgs::SetModelState setmodelstate;
+    char s[20];
+    sprintf(s, "robot_%d", call->id);
+    setmodelstate.request.model_state.model_name = (std::string) s;
+    setmodelstate.request.model_state.pose.position.x = call->pose[0];
+    setmodelstate.request.model_state.pose.position.y = call->pose[1];
+    setmodelstate.request.model_state.pose.position.z = call->pose[2];
+    setmodelstate.request.model_state.pose.orientation.x = call->pose[3];
+    setmodelstate.request.model_state.pose.orientation.y = call->pose[4];
+    setmodelstate.request.model_state.pose.orientation.z = call->pose[5];
+    setmodelstate.request.model_state.pose.orientation.w = call->pose[6];
+    connectPoseClients(call->id);
+    call->ok = sclients[call->id].call(setmodelstate);
+    if (!call->ok)
+        ROS_ERROR("Failed to call service set_model_state for %s", s);
+    return 0;
+}
+
+// issue one call per robot at the same time and wait for all. returns number of succeeded calls.
+int runPoseCalls(void *(*func)(void *), vector< vector<float> > & poses, vector<bool> * oks = NULL)
+{
+    int num = poses.size();
+    vector<PoseCall> calls(num);
+    vector<pthread_t> ids(num);
+    vector<bool> started(num, false);
+    for (int rid = 0; rid < num; ++rid)
+    {
+        calls[rid].id = rid;
+        calls[rid].pose = &poses[rid][0];
+        calls[rid].ok = false;
+        if (pthread_create(&ids[rid], NULL, func, &calls[rid]) == 0)
+            started[rid] = true;
+        else
+            func(&calls[rid]); // no thread, call in place
+    }
+    int succeed = 0;
+    if (oks)
+        oks->assign(num, false);
+    for (int rid = 0; rid < num; ++rid)
+    {
+        if (started[rid])
+            pthread_join(ids[rid], NULL);
+        if (calls[rid].ok)
+            succeed++;
+        if (oks)
+            (*oks)[rid] = calls[rid].ok;
+    }
+    return succeed;
+}
+
+// poses of all robots, fetched concurrently. a robot whose call fails keeps its last known pose.
+// false if some robot has no pose at all, its entry is zeros then.
+bool getPoses(vector< vector<float> > & poses)
+{
+    poses.assign(rbtnum, vector<float>(7, 0));
+    known_poses.resize(rbtnum);
+    vector<bool> oks;
+    runPoseCalls(getPoseThread, poses, &oks);
+    bool all_known = true;
+    for (int rid = 0; rid < rbtnum; ++rid)
+    {
+        if (oks[rid])
+            known_poses[rid] = poses[rid];
+        else if (!known_poses[rid].empty())
+        {
+            printf("get pose of robot %d failed, keep its last known pose.\n", rid);
+            poses[rid] = known_poses[rid];
+        }
+        else
+            all_known = false;
+    }
+    return all_known;
+}
+
+// set poses of all robots concurrently, one round trip for the whole team.
+// frames are marked stale only once the whole batch succeeds.
+bool setPoses(vector< vector<float> > & poses)
+{
+    int succeed = runPoseCalls(setPoseThread, poses);
+    if (succeed == (int)poses.size())
+        markMoved();
+    printf("set poses for %d robots, %d succeed.\n", (int)poses.size(), succeed);
+    return succeed == (int)poses.size();
+}
+
+// yaw of a z axis quaternion
+float quatTheta(float qz, float qw)
+{
+    float theta = acos(qw)*2;
+    if(qz<0)
+        theta = -theta;
+    return theta;
+}
+
+// pose at (x, y) facing theta
+vector<float> planarPose(float x, float y, float theta)
+{
+    vector<float> p(7, 0);
+    p[0] = x;
+    p[1] = y;
+    p[2] = camera_height;
+    p[5] = sin(theta/2);
+    p[6] = cos(theta/2);
+    return p;
+}
+
 void infoCallback(const sensor_msgs::CameraInfoConstPtr &msg){
     
     //printf("cx: %lf, cy: %lf, fx: %lf, fy: %lf\n", msg->K[2], msg->K[5], msg->K[0], msg->K[4]);
@@ -204,43 +443,28 @@ void infoCallback(const sensor_msgs::CameraInfoConstPtr &msg){
     //printf("fx: %lf\n", msg->K[0]);
 }
 
-// recv
+// recv exactly len bytes, blocking. returns bytes received, 0 on error or peer closed.
 int recvData(const int client_fd, char buf[], int len)
 {
     memset (buf, 0, len);
 
     int i=0;
     while(i<len){
-        char buf_tem[MAXRECV];
-        memset (buf_tem, 0, MAXRECV);
-        int status = recv(client_fd, buf_tem, MAXRECV, 0);
-        memcpy(buf+i, buf_tem, status);
-        i = i+status;
-
-        //printf("i:%d\n", i);
-        //printf("len:%d\n", len);
-        //printf("status:%d\n", status);
-
+        int status = recv(client_fd, buf+i, len-i, 0);
         if ( status == -1 )
         {
-            printf("status == -1 errno == %s in Socket::recv\n",errno);
+            if (errno == EINTR) continue;
+            printf("status == -1 errno == %s in Socket::recv\n", strerror(errno));
             return 0;
         }
         else if( status == 0 )
         {
-            //stop(client_fd);
-            //return 0;
-            break;
-        }
-        else if(len<=MAXRECV+1)
-        {
-            break;
+            printf("peer closed in Socket::recv\n");
+            return 0;
         }
-        /*else
-        {
-        return status;
-        }*/
+        i = i+status;
     }
+    return i;
 }
 
 // send
@@ -277,12 +501,9 @@ int sendTotalData(const int client_fd, const char *buf, const int len){
 // socket get rgbd
 bool getRGBD(int client_fd){
 
-    ros::spinOnce();
-
-    ros::Rate rate(1); // 1hz
-
-    rate.sleep();
-
+    // wait for frames after the last move instead of a fixed sleep.
+    vector<cv::Mat> rgb_images, depth_images;
+    waitForFrames(rgb_images, depth_images);
 
     // rgb
     {
@@ -303,11 +524,11 @@ bool getRGBD(int client_fd){
             {
                 for (int j = 0; j < 640; ++j)
                 {
-                    memcpy(&rgbData[ind], &crt_rgb_images[rid].ptr<cv::Vec3b>(i)[j][0], sizeof(uchar));
+                    memcpy(&rgbData[ind], &rgb_images[rid].ptr<cv::Vec3b>(i)[j][0], sizeof(uchar));
                     ind+=sizeof(uchar);
-                    memcpy(&rgbData[ind], &crt_rgb_images[rid].ptr<cv::Vec3b>(i)[j][1], sizeof(uchar));
+                    memcpy(&rgbData[ind], &rgb_images[rid].ptr<cv::Vec3b>(i)[j][1], sizeof(uchar));
                     ind+=sizeof(uchar);
-                    memcpy(&rgbData[ind], &crt_rgb_images[rid].ptr<cv::Vec3b>(i)[j][2], sizeof(uchar));
+                    memcpy(&rgbData[ind], &rgb_images[rid].ptr<cv::Vec3b>(i)[j][2], sizeof(uchar));
                     ind+=sizeof(uchar);
                 }
             }
@@ -336,7 +557,7 @@ bool getRGBD(int client_fd){
             {
                 for (int j = 0; j < 640; ++j)
                 {
-                    memcpy(&depthData[ind], &crt_depth_images[rid].ptr<short>(i)[j], sizeof(short));
+                    memcpy(&depthData[ind], &depth_images[rid].ptr<short>(i)[j], sizeof(short));
                     ind+=sizeof(short);
                 }
             }
@@ -373,13 +594,14 @@ bool getPose(int client_fd)
         poseData = (char *)malloc(data_len);
     }
     // for multi robot
+    vector< vector<float> > poses;
+    getPoses(poses);
     int ind = 0;
     for (int rid = 0; rid < rbtnum; ++rid)
     {
-        callForPose(rid);
         for (int i = 0; i < 7; ++i)
         {
-            memcpy(&poseData[ind], &pose[i], sizeof(float));
+            memcpy(&poseData[ind], &poses[rid][i], sizeof(float));
             ind+=sizeof(float);
         }
     }
@@ -403,100 +625,56 @@ printf("\n");
     return true;
 }
 
-void goToPose(float x0 , float y0, float qx0, float qy0, float qz0, float qw0, 
-              float x1 , float y1, float qx1, float qy1, float qz1, float qw1, 
-              float x2 , float y2, float qx2, float qy2, float qz2, float qw2){
+// targets: x y z qx qy qz qw per robot
+void goToPose(int client_fd, vector< vector<float> > & targets){
     printf("\ngoToPose\n");
-    //printf("set to x0=%f y0=%f x1=%f y1=%f x2=%f y2=%f\n", x0, y0, x1, y1, x2, y2);
-    // rotation try
-    // pose0
-    callForPose(0);
-    float originTheta0 = acos(pose[6])*2;
-    if(pose[5]<0)
-        originTheta0 = -originTheta0;
-    float objectTheta0 = acos(qw0)*2;
-    if(qz0<0)
-        objectTheta0 = -objectTheta0;
-    float dTheta0 = objectTheta0 - originTheta0;
-    float dx0 = rbt_v * (x0 - pose[0]);
-    float dy0 = rbt_v * (y0 - pose[1]);
-    // pose1
-    callForPose(1);
-    float originTheta1 = acos(pose[6])*2;
-    if(pose[5]<0)
-        originTheta1 = -originTheta1;
-    float objectTheta1 = acos(qw1)*2;
-    if(qz1<0)
-        objectTheta1 = -objectTheta1;
-    float dTheta1 = objectTheta1 - originTheta1;
-    float dx1 = rbt_v * (x1 - pose[0]);
-    float dy1 = rbt_v * (y1 - pose[1]);
-    // pose2
-    callForPose(2);
-    float originTheta2 = acos(pose[6])*2;
-    if(pose[5]<0)
-        originTheta2 = -originTheta2;
-    float objectTheta2 = acos(qw2)*2;
-    if(qz2<0)
-        objectTheta2 = -objectTheta2;
-    float dTheta2 = objectTheta2 - originTheta2;
-    float dx2 = rbt_v * (x2 - pose[0]);
-    float dy2 = rbt_v * (y2 - pose[1]);
+    int num = targets.size();
+    // rotation and translation steps of each robot
+    vector< vector<float> > poses;
+    if (!getPoses(poses))
+    {
+        // nothing to plan the steps from, stay but still answer every step
+        printf("goToPose: robot poses unknown, step aborted.\n");
+        for (int i = 0; i < 2 * times; ++i)
+        {
+            getPose(client_fd);
+            getRGBD(client_fd);
+        }
+        return;
+    }
+    vector<float> dTheta(num), dx(num), dy(num);
+    for (int rid = 0; rid < num; ++rid)
+    {
+        dTheta[rid] = quatTheta(targets[rid][5], targets[rid][6]) - quatTheta(poses[rid][5], poses[rid][6]);
+        dx[rid] = rbt_v * (targets[rid][0] - poses[rid][0]);
+        dy[rid] = rbt_v * (targets[rid][1] - poses[rid][1]);
+    }
+    // rotate
     for (int i = 0; i < times; ++i)
     {
-        float ox = 0.0, oy = 0.0, oz = 1.0;
-        // pose 0
-        callForPose(0);
-        float crtTheta0 = acos(pose[6])*2;
-        if(pose[5]<0)
-            crtTheta0 = -crtTheta0;
-        float temp_theta0 = crtTheta0 + dTheta0/times;
-        setForPose(0, pose[0], pose[1], camera_height, ox*sin(temp_theta0/2), oy*sin(temp_theta0/2), oz*sin(temp_theta0/2), cos(temp_theta0/2));
-        // pose 1
-        callForPose(1);
-        float crtTheta1 = acos(pose[6])*2;
-        if(pose[5]<0)
-            crtTheta1 = -crtTheta1;
-        float temp_theta1 = crtTheta1 + dTheta1/times;
-        setForPose(1, pose[0], pose[1], camera_height, ox*sin(temp_theta1/2), oy*sin(temp_theta1/2), oz*sin(temp_theta1/2), cos(temp_theta1/2));
-        // pose 2
-        callForPose(2);
-        float crtTheta2 = acos(pose[6])*2;
-        if(pose[5]<0)
-            crtTheta2 = -crtTheta2;
-        float temp_theta2 = crtTheta2 + dTheta2/times;
-        setForPose(2, pose[0], pose[1], camera_height, ox*sin(temp_theta2/2), oy*sin(temp_theta2/2), oz*sin(temp_theta2/2), cos(temp_theta2/2));
+        getPoses(poses);
+        vector< vector<float> > steps(num);
+        for (int rid = 0; rid < num; ++rid)
+            steps[rid] = planarPose(poses[rid][0], poses[rid][1], quatTheta(poses[rid][5], poses[rid][6]) + dTheta[rid]/times);
+        setPoses(steps);
         // send to socket
-        ros::spinOnce();
-        ros::Rate rate(1);
-        //ros::Rate rate(10); // 01-09.
-        rate.sleep();
         //getDepth(client_fd);
         getPose(client_fd);   
         getRGBD(client_fd);
     }
     // move
     for (int i = 0; i < times; ++i){
-        //0
-        callForPose(0);
-        float tx0 = pose[0] + dx0;
-        float ty0 = pose[1] + dy0;
-        //1
-        callForPose(1);
-        float tx1 = pose[0] + dx1;
-        float ty1 = pose[1] + dy1;
-        //2
-        callForPose(2);
-        float tx2 = pose[0] + dx2;
-        float ty2 = pose[1] + dy2;
-        setForPose(0, tx0, ty0, camera_height, qx0, qy0, qz0, qw0);
-        setForPose(1, tx1, ty1, camera_height, qx1, qy1, qz1, qw1);
-        setForPose(2, tx2, ty2, camera_height, qx2, qy2, qz2, qw2);
+        getPoses(poses);
+        vector< vector<float> > steps(num);
+        for (int rid = 0; rid < num; ++rid)
+        {
+            steps[rid] = targets[rid];
+            steps[rid][0] = poses[rid][0] + dx[rid];
+            steps[rid][1] = poses[rid][1] + dy[rid];
+            steps[rid][2] = camera_height;
+        }
+        setPoses(steps);
         // send to socket
-        ros::spinOnce();
-        ros::Rate rate(1);
-        //ros::Rate rate(10); // 01-09.
-        rate.sleep();
         //getDepth(client_fd);
         getPose(client_fd);
         getRGBD(client_fd);  
@@ -520,37 +698,29 @@ bool move_to_views(int client_fd){
     //printf("before recv\n");
     int rcv_len = recvData(client_fd, poseData, data_len); // recv
     //printf("after recv\n");
-    float pass_pose[rbtnum][7];
+    vector< vector<float> > set_poses(rbtnum, vector<float>(7, 0));
     int ind = 0;
 
     // move: set poses to views
     for (int id = 0; id < rbtnum; ++id)
     {
-        float set_pose[7];
         for (int i = 0; i < 7; ++i)
         {
-            memcpy(&set_pose[i], &poseData[ind], sizeof(float));
-            memcpy(&pass_pose[id][i], &poseData[ind], sizeof(float));
+            memcpy(&set_poses[id][i], &poseData[ind], sizeof(float));
             ind+=sizeof(float);
         }
-        setForPose(id, 
-            set_pose[0], set_pose[1], set_pose[2], 
-            set_pose[3], set_pose[4], set_pose[5], set_pose[6]);
         //printf("pose for robot%d: %f, %f, %f, %f, %f, %f, %f\n", id, 
-        //    set_pose[0], set_pose[1], set_pose[2],
-        //    set_pose[3], set_pose[4], set_pose[5], set_pose[6]);
+        //    set_poses[id][0], set_poses[id][1], set_poses[id][2],
+        //    set_poses[id][3], set_poses[id][4], set_poses[id][5], set_poses[id][6]);
     }
+    setPoses(set_poses);
 
     // free 
     free(poseData);
 
     printf("func move_to_views end\n\n");
 
-    // update rgbd and pose topic
-    
-    ros::spinOnce();
-    ros::Rate rate(1);
-    rate.sleep();
+    // rgbd of the new views is awaited by the next getRGBD.
 
     return true;
 }
@@ -566,22 +736,17 @@ bool setPose(int client_fd){
         poseData = (char *)malloc(data_len);
     }
     int rcv_len = recvData(client_fd, poseData, data_len);
-    float pass_pose[rbtnum][7];
+    vector< vector<float> > pass_poses(rbtnum, vector<float>(7, 0));
     int ind = 0;
     for (int id = 0; id < rbtnum; ++id)
     {
-        float set_pose[7];
         for (int i = 0; i < 7; ++i)
         {
-            memcpy(&set_pose[i], &poseData[ind], sizeof(float));
-            memcpy(&pass_pose[id][i], &poseData[ind], sizeof(float));
+            memcpy(&pass_poses[id][i], &poseData[ind], sizeof(float));
             ind+=sizeof(float);
         }
     }
-    goToPose(
-        pass_pose[0][0], pass_pose[0][1], pass_pose[0][3], pass_pose[0][4], pass_pose[0][5], pass_pose[0][6],
-        pass_pose[1][0], pass_pose[1][1], pass_pose[1][3], pass_pose[1][4], pass_pose[1][5], pass_pose[1][6],
-        pass_pose[2][0], pass_pose[2][1], pass_pose[2][3], pass_pose[2][4], pass_pose[2][5], pass_pose[2][6]);
+    goToPose(client_fd, pass_poses);
     free(poseData);
     printf("\nsetPose: done.\n");
     return true;
@@ -865,10 +1030,6 @@ bool setPath(int client_fd){
 		}
 	}
 	// get scans // send to socket
-    ros::spinOnce();
-    ros::Rate rate(1);
-    //ros::Rate rate(10); // 01-09.
-    rate.sleep();
     getPose(client_fd);
     getRGBD(client_fd);
 
@@ -889,26 +1050,24 @@ bool scanSurroundings(int client_fd){
 	//float cover_angle = PI/3;
 	for (int i = 0; i < 6; ++i)
 	{
-		for (int rid = 0; rid < rbtnum; ++rid)
+		vector< vector<float> > poses;
+		if (getPoses(poses))
 		{
-			callForPose(rid);
-			float originTheta = acos(pose[6])*2;
-	    	if(pose[5]<0)
-	        	originTheta = -originTheta;
-	        float dir_theta = originTheta+PI/3;
-	        if(dir_theta>PI)
-	        	dir_theta = -PI + dir_theta - PI;
-	        setForPose(rid, pose[0], pose[1], camera_height, 
-	        	0.0*sin(dir_theta/2), 0.0*sin(dir_theta/2), 1.0*sin(dir_theta/2), cos(dir_theta/2));
-
-            printf("robot_%d turned 60 degree.\n", rid);
+			for (int rid = 0; rid < rbtnum; ++rid)
+			{
+				float originTheta = quatTheta(poses[rid][5], poses[rid][6]);
+		        float dir_theta = originTheta+PI/3;
+		        if(dir_theta>PI)
+		        	dir_theta = -PI + dir_theta - PI;
+		        poses[rid] = planarPose(poses[rid][0], poses[rid][1], dir_theta);
+			}
+			setPoses(poses);
+	        printf("all robots turned 60 degree.\n");
 		}
+		else
+			printf("robot poses unknown, no turn.\n");
 		// get scans // send to socket
-        printf("ros sleep and spin once to get pose and rgbd...\n");
-  	  	ros::spinOnce();
-        ros::Rate rate(1);
-        //ros::Rate rate(10); // 01-09.
-        rate.sleep();
+        printf("wait for fresh pose and rgbd...\n");
         //printf("ros getting pose...\n");
         getPose(client_fd);
         //printf("ros getting rgbd...\n");
@@ -947,7 +1106,11 @@ bool setTaskPositions(int client_fd){
 // change robot number
 void change_robot_number_local(int number)
 {
+    // drop old subscribers first, their callbacks take the frame lock.
+    subsColor.clear();
+    subsDepth.clear();
     // change robot number
+    pthread_mutex_lock(&frame_mutex);
     rbtnum = number;
     // re initialization
     {
@@ -961,6 +1124,13 @@ void change_robot_number_local(int number)
             crt_rgb_images[rid] = cv::Mat(480, 640, CV_8UC3);
             crt_depth_images[rid] = cv::Mat(480, 640, CV_16UC1);
         }
+        crt_rgb_stamps.assign(rbtnum, ros::Time());
+        crt_depth_stamps.assign(rbtnum, ros::Time());
+    }
+    pthread_mutex_unlock(&frame_mutex);
+    // pose clients
+    resetPoseClients();
+    {
         // ros topics. RGBD.
         subsColor.clear();
         subsColor.resize(rbtnum);
@@ -1004,13 +1174,20 @@ bool change_robot_number(int client_fd)
 // thread
 void *thread(void *ptr)
 {
-    int client = *(int *)ptr;
+    int client_fd = *(int *)ptr; // own copy, the accept loop reuses the global.
+    delete (int *)ptr;
     bool stopped=false;
     while(!stopped)
     {
         char message [MAXRECV+1];
+        memset(message, 0, sizeof(message));
         printf("wait for a command...\n");
-        if(recvData(client_fd, message, MAXRECV+1))
+        // commands are one byte, payload follows on the same stream. blocks until it arrives.
+        if(!recvData(client_fd, message, 1))
+        {
+            printf("connection lost\n");
+            break;
+        }
         {
             printf("message: %s\n", message);
             if(message!=NULL&&strlen(message)!=0)
@@ -1086,8 +1263,8 @@ void *thread(void *ptr)
                 }
             }
         }
-        usleep(100000); // 100 ms
     }
+    close(client_fd);
     printf("thread stop done.\n");
     return 0;
 }
@@ -1102,6 +1279,9 @@ int main(int argc, char **argv){
     ros::init(argc, argv, "octo_navi");
     ros::NodeHandle n;
     it = new image_transport::ImageTransport(n); // need release manually.
+    // callbacks run on their own threads and fill the frame slots.
+    ros::AsyncSpinner spinner(2);
+    spinner.start();
 
     // // write
     // ofs_off.open("/home/dsy/catkin_ws/src/virtual_scan/data/offline/pose_history.txt");
@@ -1127,6 +1307,8 @@ int main(int argc, char **argv){
             crt_rgb_images[rid] = cv::Mat(480, 640, CV_8UC3);
             crt_depth_images[rid] = cv::Mat(480, 640, CV_16UC1);
         }
+        crt_rgb_stamps.assign(rbtnum, ros::Time());
+        crt_depth_stamps.assign(rbtnum, ros::Time());
         // ros topics. RGBD.
         subsColor.clear();
         subsColor.resize(rbtnum);
@@ -1155,6 +1337,7 @@ int main(int argc, char **argv){
     // services: pose
     gclient = n.serviceClient<gazebo_msgs::GetModelState>("/gazebo/get_model_state");
     sclient = n.serviceClient<gazebo_msgs::SetModelState>("/gazebo/set_model_state");
+    resetPoseClients();
 
     // // test callback func
     // ros::spin();
@@ -1238,16 +1421,16 @@ int main(int argc, char **argv){
         }
 
         pthread_t id;
-        int ret = pthread_create(&id, NULL, thread, &client_fd);
+        int ret = pthread_create(&id, NULL, thread, new int(client_fd));
         if(ret!=0) 
         {
             printf("Create pthread error: %s\n", strerror(ret));
+            close(client_fd);
             continue;
         }
+        pthread_detach(id);
 
         printf("succeed connected.\n");
-
-        usleep(100000);
     }
 
     return 0;
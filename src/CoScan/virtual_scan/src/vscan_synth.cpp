@@ -0,0 +1,538 @@
+// synthetic stand-in for gazebo + vscan_server: renders depth of a 2.5D scene and answers the co_scan socket commands.
+// usage: vscan_synth <scene file> [robot number] [render threads]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+#define PI 3.1415926
+
+#define SERVPORT 3333
+const int MAXRECV = 10240;
+#define BACKLOG 10
+
+// camera, same as DataEngine and the gazebo kinect
+const int frame_rows = 480;
+const int frame_cols = 640;
+const float camera_factor = 1000;
+const float camera_cx = 320.500000;
+const float camera_cy = 240.500000;
+const float camera_fx = 554.382713;
+const float camera_fy = 554.382713;
+const float camera_far = 10.0; // meter, no return beyond
+float camera_height = 1.1;
+
+const int times = 1.0;
+float rbt_v = 1.0/times - 0.01;
+
+// 2.5D scene: height of every cell, 0 is floor.
+struct Scene
+{
+    float cellsize = 0.05;
+    float origin_x = 0;     // world x of cell column 0
+    float origin_y = 0;     // world y of cell row 0
+    int cols = 0;
+    int rows = 0;
+    vector<float> height;   // rows * cols
+    vector< vector<float> > robots; // x y theta
+    float at(int r, int c) const { return height[r * cols + c]; }
+};
+Scene scene;
+
+// robots
+int rbtnum = 3;
+vector< vector<float> > poses; // x y z qx qy qz qw
+pthread_mutex_t pose_mutex = PTHREAD_MUTEX_INITIALIZER;
+int render_threads = 4;
+
+// load a scene file. lines:
+//   cellsize <m>
+//   bounds <xmin> <ymin> <xmax> <ymax>
+//   box <x0> <y0> <x1> <y1> <height>    solid block, later boxes overwrite
+//   free <x0> <y0> <x1> <y1>            clear a block, e.g. doors
+//   robot <x> <y> <theta>               start pose
+bool loadScene(const char* path)
+{
+    ifstream ifs(path);
+    if (!ifs.is_open())
+    {
+        printf("can't open scene %s\n", path);
+        return false;
+    }
+    string line;
+    while (getline(ifs, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        stringstream ss(line);
+        string key;
+        ss >> key;
+        if (key == "cellsize")
+            ss >> scene.cellsize;
+        else if (key == "bounds")
+        {
+            float x1, y1;
+            ss >> scene.origin_x >> scene.origin_y >> x1 >> y1;
+            scene.cols = (int)ceil((x1 - scene.origin_x) / scene.cellsize);
+            scene.rows = (int)ceil((y1 - scene.origin_y) / scene.cellsize);
+            scene.height.assign(scene.rows * scene.cols, 0);
+        }
+        else if (key == "box" || key == "free")
+        {
+            if (scene.height.empty())
+            {
+                printf("scene %s: bounds must come before %s\n", path, key.c_str());
+                return false;
+            }
+            float x0, y0, x1, y1, h = 0;
+            ss >> x0 >> y0 >> x1 >> y1;
+            if (key == "box")
+                ss >> h;
+            int c0 = max(0, (int)floor((min(x0, x1) - scene.origin_x) / scene.cellsize));
+            int c1 = min(scene.cols, (int)ceil((max(x0, x1) - scene.origin_x) / scene.cellsize));
+            int r0 = max(0, (int)floor((min(y0, y1) - scene.origin_y) / scene.cellsize));
+            int r1 = min(scene.rows, (int)ceil((max(y0, y1) - scene.origin_y) / scene.cellsize));
+            for (int r = r0; r < r1; ++r)
+                for (int c = c0; c < c1; ++c)
+                    scene.height[r * scene.cols + c] = h;
+        }
+        else if (key == "robot")
+        {
+            vector<float> p(3, 0);
+            ss >> p[0] >> p[1] >> p[2];
+            scene.robots.push_back(p);
+        }
+    }
+    printf("scene %s: %d x %d cells, %d robot starts\n", path, scene.cols, scene.rows, (int)scene.robots.size());
+    return !scene.height.empty();
+}
+
+// yaw of a z axis quaternion
+float quatTheta(float qz, float qw)
+{
+    float theta = acos(qw)*2;
+    if(qz<0)
+        theta = -theta;
+    return theta;
+}
+
+// pose at (x, y) facing theta
+vector<float> planarPose(float x, float y, float theta)
+{
+    vector<float> p(7, 0);
+    p[0] = x;
+    p[1] = y;
+    p[2] = camera_height;
+    p[5] = sin(theta/2);
+    p[6] = cos(theta/2);
+    return p;
+}
+
+// robots at their scene start poses, extra robots queue behind the last start.
+void resetRobots(int number)
+{
+    pthread_mutex_lock(&pose_mutex);
+    rbtnum = number;
+    poses.resize(rbtnum);
+    for (int rid = 0; rid < rbtnum; ++rid)
+    {
+        if (rid < scene.robots.size())
+            poses[rid] = planarPose(scene.robots[rid][0], scene.robots[rid][1], scene.robots[rid][2]);
+        else if (!scene.robots.empty())
+            poses[rid] = planarPose(scene.robots.back()[0] - 0.5 * (rid - scene.robots.size() + 1), scene.robots.back()[1], scene.robots.back()[2]);
+        else
+            poses[rid] = planarPose(0, 0, 0);
+    }
+    pthread_mutex_unlock(&pose_mutex);
+}
+
+// one cell crossed by a column ray, t is the distance along the camera axis
+struct RaySpan
+{
+    float t_in;
+    float t_out;
+    float h;
+};
+
+// render job: columns of all robots, interleaved over threads
+struct RenderJob
+{
+    int tid;
+    const vector< vector<float> >* poses;
+    char* rgb;      // wire format, rbtnum * rows * cols * 3
+    short* depth;   // wire format, rbtnum * rows * cols
+};
+
+// camera has only yaw, so every pixel of a column shares the horizontal ray.
+// walk the grid once per column, then intersect each row against the crossed cells.
+void renderColumn(const vector<float> & pose, int col, char* rgb, short* depth, vector<RaySpan> & spans)
+{
+    float theta = quatTheta(pose[5], pose[6]);
+    float s = -(col - camera_cx) / camera_fx;          // lateral per unit forward
+    float dx = cos(theta) - s * sin(theta);             // world xy per unit forward
+    float dy = sin(theta) + s * cos(theta);
+    float fx = (pose[0] - scene.origin_x) / scene.cellsize; // grid coordinates
+    float fy = (pose[1] - scene.origin_y) / scene.cellsize;
+    float gx = dx / scene.cellsize;
+    float gy = dy / scene.cellsize;
+    int c = (int)floor(fx);
+    int r = (int)floor(fy);
+    int step_c = gx > 0 ? 1 : -1;
+    int step_r = gy > 0 ? 1 : -1;
+    float td_c = gx != 0 ? fabs(1.0f / gx) : 1e30f;
+    float td_r = gy != 0 ? fabs(1.0f / gy) : 1e30f;
+    float tn_c = gx != 0 ? ((gx > 0 ? (c + 1 - fx) : (fx - c)) * td_c) : 1e30f;
+    float tn_r = gy != 0 ? ((gy > 0 ? (r + 1 - fy) : (fy - r)) * td_r) : 1e30f;
+    // dda
+    spans.clear();
+    float t = 0;
+    while (t < camera_far && c >= 0 && c < scene.cols && r >= 0 && r < scene.rows)
+    {
+        float t_out = min(tn_c, tn_r);
+        spans.push_back(RaySpan{t, t_out, scene.at(r, c)});
+        t = t_out;
+        if (tn_c < tn_r) { c += step_c; tn_c += td_c; }
+        else { r += step_r; tn_r += td_r; }
+    }
+    // rows
+    for (int row = 0; row < frame_rows; ++row)
+    {
+        float dz = -(row - camera_cy) / camera_fy;      // height per unit forward
+        float hit = 0;
+        float hit_h = 0;
+        for (int k = 0; k < spans.size(); ++k)
+        {
+            const RaySpan & sp = spans[k];
+            float z_in = pose[2] + dz * sp.t_in;
+            if (z_in <= sp.h && z_in >= 0) { hit = sp.t_in; hit_h = z_in; break; } // side face
+            if (dz < 0)
+            {
+                float t_top = (sp.h - pose[2]) / dz;   // top face or floor
+                if (t_top >= sp.t_in && t_top < sp.t_out) { hit = t_top; hit_h = sp.h; break; }
+            }
+        }
+        int ind = row * frame_cols + col;
+        short d = 0;
+        if (hit > 0 && hit < camera_far)
+            d = (short)(hit * camera_factor);
+        depth[ind] = d;
+        // gray by hit height, dark when no return
+        unsigned char g = d == 0 ? 0 : (unsigned char)min(255.0f, 60 + hit_h * 80);
+        rgb[ind * 3] = g;
+        rgb[ind * 3 + 1] = g;
+        rgb[ind * 3 + 2] = g;
+    }
+}
+
+void *renderThread(void *ptr)
+{
+    RenderJob* job = (RenderJob*)ptr;
+    vector<RaySpan> spans;
+    spans.reserve(1024);
+    int num = job->poses->size();
+    for (int k = job->tid; k < num * frame_cols; k += render_threads)
+    {
+        int rid = k / frame_cols;
+        int col = k % frame_cols;
+        renderColumn((*job->poses)[rid], col,
+            job->rgb + rid * frame_rows * frame_cols * 3,
+            job->depth + rid * frame_rows * frame_cols, spans);
+    }
+    return 0;
+}
+
+// render all robots into wire format buffers
+void renderAll(const vector< vector<float> > & ps, char* rgb, short* depth)
+{
+    vector<pthread_t> ids(render_threads);
+    vector<RenderJob> jobs(render_threads);
+    for (int t = 0; t < render_threads; ++t)
+    {
+        jobs[t].tid = t;
+        jobs[t].poses = &ps;
+        jobs[t].rgb = rgb;
+        jobs[t].depth = depth;
+        pthread_create(&ids[t], NULL, renderThread, &jobs[t]);
+    }
+    for (int t = 0; t < render_threads; ++t)
+        pthread_join(ids[t], NULL);
+}
+
+// wall seconds
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// recv exactly len bytes, blocking. returns bytes received, 0 on error or peer closed.
+int recvData(const int client_fd, char buf[], int len)
+{
+    memset (buf, 0, len);
+    int i=0;
+    while(i<len){
+        int status = recv(client_fd, buf+i, len-i, 0);
+        if ( status == -1 )
+        {
+            if (errno == EINTR) continue;
+            printf("status == -1 errno == %s in Socket::recv\n", strerror(errno));
+            return 0;
+        }
+        else if( status == 0 )
+            return 0;
+        i = i+status;
+    }
+    return i;
+}
+
+// send data
+int sendTotalData(const int client_fd, const char *buf, const int len){
+    int total = 0;
+    int n = 0;
+    while(total < len) {
+        n = send(client_fd, buf+total, len-total, 0);
+        if (n == -1) { break; }
+        total += n;
+    }
+    return n==-1 ? 0:1;
+}
+
+// socket get pose
+bool getPose(int client_fd)
+{
+    pthread_mutex_lock(&pose_mutex);
+    vector<float> data;
+    for (int rid = 0; rid < rbtnum; ++rid)
+        data.insert(data.end(), poses[rid].begin(), poses[rid].end());
+    pthread_mutex_unlock(&pose_mutex);
+    return sendTotalData(client_fd, (char*)&data[0], data.size() * sizeof(float));
+}
+
+// socket get rgbd
+bool getRGBD(int client_fd)
+{
+    pthread_mutex_lock(&pose_mutex);
+    vector< vector<float> > ps = poses;
+    pthread_mutex_unlock(&pose_mutex);
+    int num = ps.size();
+    vector<char> rgb(num * frame_rows * frame_cols * 3);
+    vector<short> depth(num * frame_rows * frame_cols);
+    double tb = now();
+    renderAll(ps, &rgb[0], &depth[0]);
+    double te = now();
+    printf("rendered %d frames in %.1f ms, %.1f frames/s\n", num, (te - tb) * 1000, num / (te - tb));
+    if (!sendTotalData(client_fd, &rgb[0], rgb.size()))
+        return false;
+    return sendTotalData(client_fd, (char*)&depth[0], depth.size() * sizeof(short));
+}
+
+// recv rbtnum * 7 floats
+bool recvPoses(int client_fd, vector< vector<float> > & ps)
+{
+    vector<float> data(rbtnum * 7);
+    if (!recvData(client_fd, (char*)&data[0], data.size() * sizeof(float)))
+        return false;
+    ps.assign(rbtnum, vector<float>(7, 0));
+    for (int rid = 0; rid < rbtnum; ++rid)
+        for (int i = 0; i < 7; ++i)
+            ps[rid][i] = data[rid * 7 + i];
+    return true;
+}
+
+// socket set pose: rotate, scan, move, scan. same steps as vscan_server goToPose.
+bool setPose(int client_fd)
+{
+    vector< vector<float> > targets;
+    if (!recvPoses(client_fd, targets))
+        return false;
+    for (int i = 0; i < times; ++i)
+    {
+        pthread_mutex_lock(&pose_mutex);
+        for (int rid = 0; rid < rbtnum; ++rid)
+        {
+            float crt = quatTheta(poses[rid][5], poses[rid][6]);
+            float obj = quatTheta(targets[rid][5], targets[rid][6]);
+            poses[rid] = planarPose(poses[rid][0], poses[rid][1], crt + (obj - crt) / (times - i));
+        }
+        pthread_mutex_unlock(&pose_mutex);
+        getPose(client_fd);
+        getRGBD(client_fd);
+    }
+    for (int i = 0; i < times; ++i)
+    {
+        pthread_mutex_lock(&pose_mutex);
+        for (int rid = 0; rid < rbtnum; ++rid)
+        {
+            vector<float> p = targets[rid];
+            p[0] = poses[rid][0] + rbt_v * (targets[rid][0] - poses[rid][0]);
+            p[1] = poses[rid][1] + rbt_v * (targets[rid][1] - poses[rid][1]);
+            p[2] = camera_height;
+            poses[rid] = p;
+        }
+        pthread_mutex_unlock(&pose_mutex);
+        getPose(client_fd);
+        getRGBD(client_fd);
+    }
+    return true;
+}
+
+// socket move to views
+bool move_to_views(int client_fd)
+{
+    vector< vector<float> > targets;
+    if (!recvPoses(client_fd, targets))
+        return false;
+    pthread_mutex_lock(&pose_mutex);
+    poses = targets;
+    pthread_mutex_unlock(&pose_mutex);
+    return true;
+}
+
+// set up: turn every robot 6 times by 60 degree
+bool scanSurroundings(int client_fd)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        pthread_mutex_lock(&pose_mutex);
+        for (int rid = 0; rid < rbtnum; ++rid)
+        {
+            float dir_theta = quatTheta(poses[rid][5], poses[rid][6]) + PI/3;
+            if(dir_theta>PI)
+                dir_theta = -PI + dir_theta - PI;
+            poses[rid] = planarPose(poses[rid][0], poses[rid][1], dir_theta);
+        }
+        pthread_mutex_unlock(&pose_mutex);
+        getPose(client_fd);
+        getRGBD(client_fd);
+    }
+    return true;
+}
+
+// thread
+void *thread(void *ptr)
+{
+    int client_fd = *(int *)ptr;
+    delete (int *)ptr;
+    bool stopped=false;
+    while(!stopped)
+    {
+        char message[2];
+        if(!recvData(client_fd, message, 1))
+            break;
+        switch(message[0])
+        {
+            case '1': getPose(client_fd); break;
+            case '2': setPose(client_fd); break;
+            case '3': getRGBD(client_fd); break;
+            case '4': getPose(client_fd); getRGBD(client_fd); break; // path moves are not simulated, like vscan_server
+            case '5': scanSurroundings(client_fd); break;
+            case '6':
+            {
+                vector<char> data(rbtnum * 2 * sizeof(float));
+                recvData(client_fd, &data[0], data.size()); // task positions are not used
+                break;
+            }
+            case 'm': move_to_views(client_fd); break;
+            case 'e': stopped = true; break;
+            case 'n':
+            {
+                int number = rbtnum;
+                if (recvData(client_fd, (char*)&number, sizeof(int)) && number > 0)
+                    resetRobots(number);
+                printf("changed robot number: %d\n", rbtnum);
+                break;
+            }
+            default: printf("invalid command %c\n", message[0]); break;
+        }
+    }
+    close(client_fd);
+    return 0;
+}
+
+// enter point
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: vscan_synth <scene file> [robot number] [render threads]\n");
+        return 1;
+    }
+    if (!loadScene(argv[1]))
+        return 1;
+    int number = argc > 2 ? atoi(argv[2]) : 3;
+    render_threads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (render_threads < 1) render_threads = 1;
+    resetRobots(number);
+    printf("robot number = %d, render threads = %d\n", rbtnum, render_threads);
+
+    // render benchmark before serving
+    {
+        vector<char> rgb(rbtnum * frame_rows * frame_cols * 3);
+        vector<short> depth(rbtnum * frame_rows * frame_cols);
+        double tb = now();
+        for (int i = 0; i < 10; ++i)
+            renderAll(poses, &rgb[0], &depth[0]);
+        double te = now();
+        printf("warm up: %.1f frames/s\n", 10 * rbtnum / (te - tb));
+    }
+
+    // socket
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == -1)
+    {
+        perror("socket");
+        exit(1);
+    }
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in my_addr;
+    memset(&my_addr, 0, sizeof(my_addr));
+    my_addr.sin_family=AF_INET;
+    my_addr.sin_port=htons(SERVPORT);
+    my_addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(sockfd, (struct sockaddr *)&my_addr, sizeof(struct sockaddr)) == -1)
+    {
+        perror("bind");
+        exit(1);
+    }
+    if (listen(sockfd, BACKLOG) == -1)
+    {
+        perror("listen");
+        exit(1);
+    }
+    while (1)
+    {
+        printf("%s\n", "waiting for a connection");
+        int client_fd = accept(sockfd, NULL, NULL);
+        if (client_fd == -1)
+        {
+            perror("failed");
+            continue;
+        }
+        int flag = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(int));
+        pthread_t id;
+        if (pthread_create(&id, NULL, thread, new int(client_fd)) != 0)
+        {
+            close(client_fd);
+            continue;
+        }
+        pthread_detach(id);
+    }
+    return 0;
+}